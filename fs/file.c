@@ -309,21 +309,17 @@ static unsigned int sane_fdtable_size(struct fdtable *fdt, unsigned int max_fds)
 }
 
 /*
- * Allocate a new files structure and copy contents from the
- * passed in files structure.
- * errorp will be valid only when the returned files_struct is NULL.
+ * Allocate a new files structure using its embedded fd table, the contents
+ * of which are left to the caller.
  */
-struct files_struct *dup_fd(struct files_struct *oldf, unsigned int max_fds, int *errorp)
+static struct files_struct *alloc_files_struct(void)
 {
 	struct files_struct *newf;
-	struct file **old_fds, **new_fds;
-	unsigned int open_files, i;
-	struct fdtable *old_fdt, *new_fdt;
+	struct fdtable *new_fdt;
 
-	*errorp = -ENOMEM;
 	newf = kmem_cache_alloc(files_cachep, GFP_KERNEL);
 	if (!newf)
-		goto out;
+		return NULL;
 
 	atomic_set(&newf->count, 1);
 
@@ -338,6 +334,27 @@ struct files_struct *dup_fd(struct files_struct *oldf, unsigned int max_fds, int
 	new_fdt->full_fds_bits = newf->full_fds_bits_init;
 	new_fdt->fd = &newf->fd_array[0];
 
+	return newf;
+}
+
+/*
+ * Allocate a new files structure and copy contents from the
+ * passed in files structure.
+ * errorp will be valid only when the returned files_struct is NULL.
+ */
+struct files_struct *dup_fd(struct files_struct *oldf, unsigned int max_fds, int *errorp)
+{
+	struct files_struct *newf;
+	struct file **old_fds, **new_fds;
+	unsigned int open_files, i;
+	struct fdtable *old_fdt, *new_fdt;
+
+	*errorp = -ENOMEM;
+	newf = alloc_files_struct();
+	if (!newf)
+		goto out;
+
+	new_fdt = &newf->fdtab;
 	spin_lock(&oldf->file_lock);
 	old_fdt = files_fdtable(oldf);
 	open_files = sane_fdtable_size(old_fdt, max_fds);
@@ -409,6 +426,88 @@ struct files_struct *dup_fd(struct files_struct *oldf, unsigned int max_fds, int
 	return NULL;
 }
 
+/*
+ * Allocate a new files structure holding only the @nr_fds file descriptors
+ * of the passed in files structure listed in @fds, under the same numbers
+ * and with the same close-on-exec flags.  Unlike dup_fd(), the cost does
+ * not depend on the number of files open in @oldf, but the new table is
+ * allocated and cleared up to the highest listed descriptor.
+ * errorp will be valid only when the returned files_struct is NULL.
+ */
+struct files_struct *dup_fd_select(struct files_struct *oldf,
+				   const unsigned int *fds, unsigned int nr_fds,
+				   int *errorp)
+{
+	struct files_struct *newf;
+	struct fdtable *old_fdt, *new_fdt;
+	unsigned int i, max_fd = 0;
+
+	for (i = 0; i < nr_fds; i++) {
+		if (fds[i] >= sysctl_nr_open) {
+			*errorp = -EBADF;
+			return NULL;
+		}
+		max_fd = max(max_fd, fds[i]);
+	}
+
+	*errorp = -ENOMEM;
+	newf = alloc_files_struct();
+	if (!newf)
+		return NULL;
+
+	new_fdt = &newf->fdtab;
+	if (max_fd >= new_fdt->max_fds) {
+		new_fdt = alloc_fdtable(max_fd);
+		if (!new_fdt)
+			goto out_release;
+
+		/* beyond sysctl_nr_open; nothing to do */
+		if (unlikely(new_fdt->max_fds <= max_fd)) {
+			__free_fdtable(new_fdt);
+			*errorp = -EMFILE;
+			goto out_release;
+		}
+	}
+
+	memset(new_fdt->open_fds, 0, new_fdt->max_fds / BITS_PER_BYTE);
+	memset(new_fdt->close_on_exec, 0, new_fdt->max_fds / BITS_PER_BYTE);
+	memset(new_fdt->full_fds_bits, 0, BITBIT_SIZE(new_fdt->max_fds));
+	memset(new_fdt->fd, 0, new_fdt->max_fds * sizeof(struct file *));
+	rcu_assign_pointer(newf->fdt, new_fdt);
+
+	spin_lock(&oldf->file_lock);
+	old_fdt = files_fdtable(oldf);
+	for (i = 0; i < nr_fds; i++) {
+		unsigned int fd = fds[i];
+		struct file *f;
+
+		/* listed more than once */
+		if (test_bit(fd, new_fdt->open_fds))
+			continue;
+
+		f = files_lookup_fd_locked(oldf, fd);
+		if (!f) {
+			spin_unlock(&oldf->file_lock);
+			*errorp = -EBADF;
+			put_files_struct(newf);
+			return NULL;
+		}
+
+		get_file(f);
+		__set_open_fd(fd, new_fdt);
+		if (close_on_exec(fd, old_fdt))
+			__set_close_on_exec(fd, new_fdt);
+		rcu_assign_pointer(new_fdt->fd[fd], f);
+	}
+	spin_unlock(&oldf->file_lock);
+
+	return newf;
+
+out_release:
+	kmem_cache_free(files_cachep, newf);
+	return NULL;
+}
+
 static struct fdtable *close_files(struct files_struct * files)
 {
 	/*
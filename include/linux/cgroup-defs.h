@@ -506,10 +506,17 @@ struct cgroup {
 	/*
 	 * A singly-linked list of cgroup structures to be rstat flushed.
 	 * This is a scratch field to be used exclusively by
-	 * cgroup_rstat_flush_locked() and protected by cgroup_rstat_lock.
+	 * cgroup_rstat_flush_locked() and owned by the flush which took the
+	 * cgroup off the ->updated_children lists.
 	 */
 	struct cgroup	*rstat_flush_next;
 
+	/* entry in the list of flushed subtrees while this subtree is flushed */
+	struct list_head rstat_flush_node;
+
+	/* jiffies at the start of the last flush of this subtree */
+	unsigned long rstat_flush_time;
+
 	/* cgroup basic resource statistics */
 	struct cgroup_base_stat last_bstat;
 	struct cgroup_base_stat bstat;
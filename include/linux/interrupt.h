@@ -67,6 +67,10 @@
  *                later.
  * IRQF_NO_DEBUG - Exclude from runnaway detection for IPI and similar handlers,
  *		   depends on IRQF_PERCPU.
+ * IRQF_THREAD_POLL - The interrupt thread polls the device with the line
+ *                masked: thread_fn is called again as long as it returns
+ *                IRQ_HANDLED, and the line is unmasked once it returns
+ *                IRQ_NONE or the poll budget is spent. Implies IRQF_ONESHOT.
  */
 #define IRQF_SHARED		0x00000080
 #define IRQF_PROBE_SHARED	0x00000100
@@ -82,6 +86,7 @@
 #define IRQF_COND_SUSPEND	0x00040000
 #define IRQF_NO_AUTOEN		0x00080000
 #define IRQF_NO_DEBUG		0x00100000
+#define IRQF_THREAD_POLL	0x00200000
 
 #define IRQF_TIMER		(__IRQF_TIMER | IRQF_NO_SUSPEND | IRQF_NO_THREAD)
 
@@ -77,6 +77,11 @@ struct irq_desc {
 #ifdef CONFIG_GENERIC_PENDING_IRQ
 	cpumask_var_t		pending_mask;
 #endif
+#ifdef CONFIG_IRQ_BALANCE
+	u64			balance_ns;	/* time spent in the handlers */
+	u64			balance_prev_ns;
+	int			balance_cpu;	/* CPU the balancer picked */
+#endif
 #endif
 	unsigned long		threads_oneshot;
 	atomic_t		threads_active;
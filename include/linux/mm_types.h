@@ -934,6 +934,10 @@ struct mm_struct {
 		atomic_t tlb_flush_batched;
 #endif
 		struct uprobes_state uprobes_state;
+#ifdef CONFIG_FUTEX
+		/* Hash table of the private futexes, see futex_hash() */
+		struct futex_private_hash *futex_phash;
+#endif
 #ifdef CONFIG_PREEMPT_RT
 		struct rcu_head delayed_drop;
 #endif
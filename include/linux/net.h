@@ -195,6 +195,13 @@ struct proto_ops {
 	void		(*show_fdinfo)(struct seq_file *m, struct socket *sock);
 	int		(*sendmsg)   (struct socket *sock, struct msghdr *m,
 				      size_t total_len);
+	/* Send the datagrams of a sendmmsg() call at once, instead of one
+	 * sendmsg() each. The messages have been checked as for sendmsg().
+	 * Returns the number of messages sent, or the error sending the
+	 * first one.
+	 */
+	int		(*sendmmsg)  (struct socket *sock, struct msghdr *msgs,
+				      unsigned int vlen);
 	/* Notes for implementing recvmsg:
 	 * ===============================
 	 * msg->msg_namelen should get updated by the recvmsg handlers
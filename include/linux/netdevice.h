@@ -34,6 +34,7 @@
 #include <linux/rculist.h>
 #include <linux/workqueue.h>
 #include <linux/dynamic_queue_limits.h>
+#include <linux/u64_stats_sync.h>
 
 #include <net/net_namespace.h>
 #ifdef CONFIG_DCB
@@ -343,10 +344,28 @@ struct gro_list {
 };
 
 /*
- * size of gro hash buckets, must less than bit number of
- * napi_struct::gro_bitmask
+ * maximum number of gro hash buckets, at most the bit number of
+ * napi_struct::gro_bitmask.  Each NAPI allocates
+ * net_device::gro_hash_buckets of them, the default fits in
+ * napi_struct::gro_hash_inline.
  */
-#define GRO_HASH_BUCKETS	8
+#define GRO_HASH_BUCKETS	32
+#define GRO_HASH_BUCKETS_DEFAULT	8
+
+/* default and maximum number of packets held per GRO bucket */
+#define GRO_BUCKET_FLOWS_DEFAULT	8
+#define GRO_BUCKET_FLOWS_MAX		64
+
+/* GRO effectiveness counters, summed over everything napi_gro_flush()
+ * and eviction completed: flushes is the number of skbs sent up the
+ * stack from the hold lists, segs the wire packets they carried.
+ */
+struct napi_gro_stats {
+	u64_stats_t		flushes;
+	u64_stats_t		segs;
+	u64_stats_t		evictions;
+	struct u64_stats_sync	syncp;
+};
 
 /*
  * Structure for NAPI scheduling similar to tasklet but with weighting
@@ -372,17 +391,20 @@ struct napi_struct {
 	/* CPU on which NAPI has been scheduled for processing */
 	int			list_owner;
 	struct net_device	*dev;
-	struct gro_list		gro_hash[GRO_HASH_BUCKETS];
+	struct gro_list		*gro_hash;
+	unsigned int		gro_hash_buckets;
 	struct sk_buff		*skb;
 	struct list_head	rx_list; /* Pending GRO_NORMAL skbs */
 	int			rx_count; /* length of rx_list */
 	unsigned int		napi_id;
 	struct hrtimer		timer;
 	struct task_struct	*thread;
+	struct napi_gro_stats	gro_stats;
 	/* control-path-only fields follow */
 	struct list_head	dev_list;
 	struct hlist_node	napi_hash_node;
 	int			irq;
+	struct gro_list		gro_hash_inline[GRO_HASH_BUCKETS_DEFAULT];
 };
 
 enum {
@@ -558,6 +580,7 @@ static inline bool napi_complete(struct napi_struct *n)
 }
 
 int dev_set_threaded(struct net_device *dev, bool threaded);
+int dev_set_gro_hash_buckets(struct net_device *dev, unsigned int buckets);
 
 /**
  *	napi_disable - prevent NAPI from scheduling
@@ -2074,6 +2097,11 @@ enum netdev_stat_type {
  *			receive offload (GRO)
  * 	@gro_ipv4_max_size:	Maximum size of aggregated packet in generic
  * 				receive offload (GRO), for IPv4.
+ *	@gro_hash_buckets:	Number of GRO hash buckets allocated per NAPI,
+ *				a power of two up to GRO_HASH_BUCKETS. Only
+ *				changed while the device is down.
+ *	@gro_bucket_flows:	Maximum number of packets held per GRO bucket
+ *				before the least recently merged is flushed
  *	@xdp_zc_max_segs:	Maximum number of segments supported by AF_XDP
  *				zero copy driver
  *
@@ -2150,6 +2178,8 @@ struct net_device {
 	int			napi_defer_hard_irqs;
 	unsigned int		gro_max_size;
 	unsigned int		gro_ipv4_max_size;
+	u16			gro_hash_buckets;
+	u16			gro_bucket_flows;
 	rx_handler_func_t __rcu	*rx_handler;
 	void __rcu		*rx_handler_data;
 	possible_net_t			nd_net;
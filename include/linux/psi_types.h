@@ -75,6 +75,9 @@ enum psi_states {
 /* Flag whether to re-arm avgs_work, see details in get_recent_times() */
 #define PSI_STATE_RESCHEDULE	(1 << (NR_PSI_STATES + 1))
 
+/* Flag a group folded into a descendant on this CPU, see psi_fold() */
+#define PSI_STATE_FOLDED	(1 << (NR_PSI_STATES + 2))
+
 enum psi_aggregators {
 	PSI_AVGS = 0,
 	PSI_POLL,
@@ -115,6 +115,25 @@ static inline void call_rcu_hurry(struct rcu_head *head, rcu_callback_t func)
 }
 #endif
 
+/*
+ * Batched RCU callbacks: objects queued with call_rcu_batch() are handed to
+ * the handler of their rcu_batch as a NULL-terminated list of rcu_heads,
+ * linked through ->next, once a grace period has elapsed.
+ */
+typedef void (*rcu_batch_func_t)(struct rcu_head *list);
+
+struct rcu_batch_cpu;
+
+struct rcu_batch {
+	rcu_batch_func_t func;
+	struct rcu_batch_cpu __percpu *pcpu;
+};
+
+int rcu_batch_init(struct rcu_batch *rb, rcu_batch_func_t func);
+void rcu_batch_destroy(struct rcu_batch *rb);
+void call_rcu_batch(struct rcu_batch *rb, struct rcu_head *head);
+void rcu_batch_barrier(struct rcu_batch *rb);
+
 /* Internal to kernel */
 void rcu_init(void);
 extern int rcu_scheduler_active;
@@ -53,6 +53,14 @@ struct rw_semaphore {
 	 * check to see if the write owner is running on the cpu.
 	 */
 	atomic_long_t owner;
+#ifdef CONFIG_RWSEM_READER_BIAS
+	/*
+	 * Readers may take the lock through the visible readers table
+	 * instead of count, see rwsem.c. Only read by readers while set.
+	 */
+	int rbias;
+	u64 rbias_inhibit_until;
+#endif
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	struct optimistic_spin_queue osq; /* spinner MCS lock */
 #endif
@@ -66,10 +74,22 @@ struct rw_semaphore {
 #endif
 };
 
-/* In all implementations count != 0 means locked */
+#ifdef CONFIG_RWSEM_READER_BIAS
+extern bool rwsem_rbias_is_locked(struct rw_semaphore *sem);
+#else
+static inline bool rwsem_rbias_is_locked(struct rw_semaphore *sem)
+{
+	return false;
+}
+#endif
+
+/*
+ * In all implementations count != 0 means locked; reader-biased readers do
+ * not show in count.
+ */
 static inline int rwsem_is_locked(struct rw_semaphore *sem)
 {
-	return atomic_long_read(&sem->count) != 0;
+	return atomic_long_read(&sem->count) != 0 || rwsem_rbias_is_locked(sem);
 }
 
 #define RWSEM_UNLOCKED_VALUE		0L
@@ -239,9 +259,18 @@ do {								\
 	typecheck(struct lockdep_map *, &(nest_lock)->dep_map);	\
 	_down_write_nest_lock(sem, &(nest_lock)->dep_map);	\
 } while (0)
+#else
+# define down_read_nested(sem, subclass)		down_read(sem)
+# define down_read_killable_nested(sem, subclass)	down_read_killable(sem)
+# define down_write_nest_lock(sem, nest_lock)	down_write(sem)
+# define down_write_nested(sem, subclass)	down_write(sem)
+# define down_write_killable_nested(sem, subclass)	down_write_killable(sem)
+#endif
 
+#if defined(CONFIG_DEBUG_LOCK_ALLOC) || defined(CONFIG_RWSEM_READER_BIAS)
 /*
- * Take/release a lock when not the owner will release it.
+ * Take/release a lock when not the owner will release it. Reader-biased
+ * holds can only be released by their owner, so these never use the bias.
  *
  * [ This API should be avoided as much as possible - the
  *   proper abstraction for this case is completions. ]
@@ -249,11 +278,6 @@ do {								\
 extern void down_read_non_owner(struct rw_semaphore *sem);
 extern void up_read_non_owner(struct rw_semaphore *sem);
 #else
-# define down_read_nested(sem, subclass)		down_read(sem)
-# define down_read_killable_nested(sem, subclass)	down_read_killable(sem)
-# define down_write_nest_lock(sem, nest_lock)	down_write(sem)
-# define down_write_nested(sem, subclass)	down_write(sem)
-# define down_write_killable_nested(sem, subclass)	down_write_killable(sem)
 # define down_read_non_owner(sem)		down_read(sem)
 # define up_read_non_owner(sem)			up_read(sem)
 #endif
@@ -2015,6 +2015,13 @@ extern struct task_struct *find_get_task_by_vpid(pid_t nr);
 
 extern int wake_up_state(struct task_struct *tsk, unsigned int state);
 extern int wake_up_process(struct task_struct *tsk);
+#ifdef CONFIG_SMP
+extern void wake_up_batch_begin(void);
+extern void wake_up_batch_end(void);
+#else
+static inline void wake_up_batch_begin(void) { }
+static inline void wake_up_batch_end(void) { }
+#endif
 extern void wake_up_new_task(struct task_struct *tsk);
 
 #ifdef CONFIG_SMP
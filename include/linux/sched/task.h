@@ -36,6 +36,10 @@ struct kernel_clone_args {
 	/* Number of elements in *set_tid */
 	size_t set_tid_size;
 	int cgroup;
+	/* File descriptors to copy for CLONE_SELECT_FILES */
+	unsigned int *fds;
+	/* Number of elements in *fds */
+	size_t fds_size;
 	int idle;
 	int (*fn)(void *);
 	void *fn_arg;
@@ -82,6 +82,12 @@ struct sched_domain_shared {
 	atomic_t	nr_busy_cpus;
 	int		has_idle_cores;
 	int		nr_idle_scan;
+
+	/*
+	 * Idle CPUs followed by idle cores (first SMT sibling) of the LLC,
+	 * see sds_idle_cpus() and sds_idle_cores().
+	 */
+	unsigned long	idle_span[];
 };
 
 struct sched_domain {
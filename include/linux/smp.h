@@ -44,6 +44,14 @@ do {						\
  */
 extern void __smp_call_single_queue(int cpu, struct llist_node *node);
 
+/*
+ * Same, but leave the IPI to a smp_send_deferred_call_ipis() right after
+ * queueing to the other targets, so that several targets can be kicked
+ * together.
+ */
+extern void __smp_call_single_queue_deferred(int cpu, struct llist_node *node);
+extern void smp_send_deferred_call_ipis(void);
+
 /* total number of cpus in this system (may exceed NR_CPUS) */
 extern unsigned int total_cpus;
 
@@ -332,6 +332,7 @@ void tcp_shutdown(struct sock *sk, int how);
 
 int tcp_v4_early_demux(struct sk_buff *skb);
 int tcp_v4_rcv(struct sk_buff *skb);
+void tcp_v4_rcv_list(struct list_head *head);
 
 void tcp_remove_empty_skb(struct sock *sk);
 int tcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t size);
@@ -53,7 +53,8 @@
  *     struct {
  *       u32 size    : 2,
  *           numa    : 1,
- *                   : 4,
+ *           spin    : 1,
+ *                   : 3,
  *           private : 1;
  *     };
  *   };
@@ -63,7 +64,7 @@
 #define FUTEX2_SIZE_U32		0x02
 #define FUTEX2_SIZE_U64		0x03
 #define FUTEX2_NUMA		0x04
-			/*	0x08 */
+#define FUTEX2_SPIN		0x08	/* futex_wait(): spin while the owner TID runs */
 			/*	0x10 */
 			/*	0x20 */
 			/*	0x40 */
@@ -71,6 +72,15 @@
 
 #define FUTEX2_SIZE_MASK	0x03
 
+/*
+ * With FUTEX2_NUMA, the futex word is followed by a u32 holding the NUMA node
+ * whose hash table the futex lives in. FUTEX_NO_NODE there lets the kernel
+ * pick the node of the first task using the futex and store it. Operations
+ * through a read-only mapping fail with EFAULT while the node is
+ * FUTEX_NO_NODE, as it can't be stored.
+ */
+#define FUTEX_NO_NODE		(-1)
+
 /* do not use */
 #define FUTEX_32		FUTEX2_SIZE_U32 /* historical accident :-( */
 
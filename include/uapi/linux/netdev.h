@@ -114,6 +114,9 @@ enum {
 	NETDEV_A_NAPI_ID,
 	NETDEV_A_NAPI_IRQ,
 	NETDEV_A_NAPI_PID,
+	NETDEV_A_NAPI_GRO_FLUSHES,
+	NETDEV_A_NAPI_GRO_SEGS,
+	NETDEV_A_NAPI_GRO_EVICTIONS,
 
 	__NETDEV_A_NAPI_MAX,
 	NETDEV_A_NAPI_MAX = (__NETDEV_A_NAPI_MAX - 1)
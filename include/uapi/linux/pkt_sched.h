@@ -945,6 +945,8 @@ enum {
 
 	TCA_FQ_WEIGHTS,		/* Weights for each band */
 
+	TCA_FQ_PACING_WHEEL,	/* u8: keep throttled flows in a timing wheel */
+
 	__TCA_FQ_MAX
 };
 
@@ -36,6 +36,7 @@
 /* Flags for the clone3() syscall. */
 #define CLONE_CLEAR_SIGHAND 0x100000000ULL /* Clear any signal handler and reset to SIG_DFL. */
 #define CLONE_INTO_CGROUP 0x200000000ULL /* Clone into a specific cgroup given the right permissions. */
+#define CLONE_SELECT_FILES 0x400000000ULL /* New file table with only the given file descriptors. */
 
 /*
  * cloning flags intersect with CSIGNAL so can be used with unshare and clone3
@@ -84,6 +85,15 @@
  *                kernel's limit of nested PID namespaces.
  * @cgroup:       If CLONE_INTO_CGROUP is specified set this to
  *                a file descriptor for the cgroup.
+ * @fds:          If CLONE_SELECT_FILES is specified, pointer to an
+ *                array of type __u32 of file descriptors of the
+ *                caller. The child process starts with a new file
+ *                table holding only these file descriptors, under
+ *                the same numbers and with the same close-on-exec
+ *                flags. The size of the array is defined using
+ *                @fds_size, which may be 0 for an empty table.
+ * @fds_size:     This defines the size of the array referenced
+ *                in @fds.
  *
  * The structure is versioned by size and thus extensible.
  * New struct members must go at the end of the struct and
@@ -101,12 +111,15 @@ struct clone_args {
 	__aligned_u64 set_tid;
 	__aligned_u64 set_tid_size;
 	__aligned_u64 cgroup;
+	__aligned_u64 fds;
+	__aligned_u64 fds_size;
 };
 #endif
 
 #define CLONE_ARGS_SIZE_VER0 64 /* sizeof first published struct */
 #define CLONE_ARGS_SIZE_VER1 80 /* sizeof second published struct */
 #define CLONE_ARGS_SIZE_VER2 88 /* sizeof third published struct */
+#define CLONE_ARGS_SIZE_VER3 104 /* sizeof fourth published struct */
 
 /*
  * Scheduling policies
@@ -2,14 +2,60 @@
 #include "cgroup-internal.h"
 
 #include <linux/sched/cputime.h>
+#include <linux/moduleparam.h>
+#include <linux/sched/wake_q.h>
 
 #include <linux/bpf.h>
 #include <linux/btf.h>
 #include <linux/btf_ids.h>
 
-static DEFINE_SPINLOCK(cgroup_rstat_lock);
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "cgroup."
+
+/*
+ * Flushes of disjoint subtrees run in parallel.  cgroup_rstat_flushers lists
+ * the roots of the subtrees being flushed and a flush waits until no other
+ * flush covers its root, one of its descendants or one of its ancestors.
+ * Waiting flushes queue up in order on cgroup_rstat_flush_waiters and a flush
+ * doesn't overtake an overlapping one which waits longer, so that a stream of
+ * flushes of the descendants of a cgroup can't starve a flush of the cgroup.
+ *
+ * Only the waiters overlapping a subtree can be held back by its flush, so
+ * when it ends, these are the only ones checked.  Those which can go are
+ * handed their subtree and woken up, the others keep sleeping.
+ */
+static DEFINE_SPINLOCK(cgroup_rstat_flush_lock);
+static LIST_HEAD(cgroup_rstat_flushers);
+static LIST_HEAD(cgroup_rstat_flush_waiters);
+
+struct cgroup_rstat_flush_waiter {
+	struct list_head	node;
+	struct cgroup		*cgrp;
+	/* Cleared once the subtree is handed over */
+	struct task_struct	*task;
+};
+
+#ifdef CONFIG_LOCKDEP
+static struct lockdep_map cgroup_rstat_flush_map =
+	STATIC_LOCKDEP_MAP_INIT("cgroup_rstat_flush", &cgroup_rstat_flush_map);
+#endif
+
+/*
+ * The root of a subtree propagates its stats to its parent, which flushes of
+ * sibling subtrees also do.  These updates are serialized by the base stat
+ * lock for the base stats and bpf, and by a lock per subsystem for the
+ * subsystem stats.
+ */
+static DEFINE_SPINLOCK(cgroup_rstat_base_lock);
+static spinlock_t cgroup_rstat_ss_lock[CGROUP_SUBSYS_COUNT];
+
 static DEFINE_PER_CPU(raw_spinlock_t, cgroup_rstat_cpu_lock);
 
+/* Staleness of the stats that readers of the stat files tolerate */
+static unsigned int cgroup_rstat_max_staleness_ms;
+module_param_named(rstat_max_staleness_ms, cgroup_rstat_max_staleness_ms, uint, 0644);
+MODULE_PARM_DESC(rstat_max_staleness_ms, "Maximum age of the stats reported by the stat files, in ms");
+
 static void cgroup_base_stat_flush(struct cgroup *cgrp, int cpu);
 
 static struct cgroup_rstat_cpu *cgroup_rstat_cpu(struct cgroup *cgrp, int cpu)
@@ -152,12 +198,9 @@ static struct cgroup *cgroup_rstat_updated_list(struct cgroup *root, int cpu)
 	unsigned long flags;
 
 	/*
-	 * The _irqsave() is needed because cgroup_rstat_lock is
-	 * spinlock_t which is a sleeping lock on PREEMPT_RT. Acquiring
-	 * this lock with the _irq() suffix only disables interrupts on
-	 * a non-PREEMPT_RT kernel. The raw_spinlock_t below disables
-	 * interrupts on both configurations. The _irqsave() ensures
-	 * that interrupts are always disabled and later restored.
+	 * Interrupts are disabled because cgroup_rstat_updated() is also
+	 * called from interrupt context, e.g. by the cputime accounting of
+	 * the tick.
 	 */
 	raw_spin_lock_irqsave(cpu_lock, flags);
 
@@ -222,38 +265,175 @@ __weak noinline void bpf_rstat_flush(struct cgroup *cgrp,
 
 __bpf_hook_end();
 
-/* see cgroup_rstat_flush() */
+/* Whether the subtrees of @a and @b overlap */
+static bool cgroup_rstat_flush_overlap(struct cgroup *a, struct cgroup *b)
+{
+	return cgroup_is_descendant(a, b) || cgroup_is_descendant(b, a);
+}
+
+/*
+ * Whether @waiter can't claim its subtree yet, because an overlapping subtree
+ * is being flushed or an overlapping flush queued up before it.  Called with
+ * cgroup_rstat_flush_lock held.
+ */
+static bool cgroup_rstat_flush_busy(struct cgroup_rstat_flush_waiter *waiter)
+{
+	struct cgroup_rstat_flush_waiter *pos;
+	struct cgroup *cgrp;
+
+	lockdep_assert_held(&cgroup_rstat_flush_lock);
+
+	list_for_each_entry(cgrp, &cgroup_rstat_flushers, rstat_flush_node)
+		if (cgroup_rstat_flush_overlap(cgrp, waiter->cgrp))
+			return true;
+
+	list_for_each_entry(pos, &cgroup_rstat_flush_waiters, node) {
+		if (pos == waiter)
+			break;
+		if (cgroup_rstat_flush_overlap(pos->cgrp, waiter->cgrp))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Hand @waiter its subtree and wake it up through @wake_q, if it is asleep.
+ * Called with cgroup_rstat_flush_lock held.
+ */
+static void cgroup_rstat_flush_grant(struct cgroup_rstat_flush_waiter *waiter,
+				     struct wake_q_head *wake_q)
+{
+	list_del(&waiter->node);
+	list_add_tail(&waiter->cgrp->rstat_flush_node, &cgroup_rstat_flushers);
+
+	if (wake_q)
+		wake_q_add(wake_q, waiter->task);
+	/* @waiter is on the waiter's stack, gone once it sees the NULL */
+	smp_store_release(&waiter->task, NULL);
+}
+
+/*
+ * Claim @cgrp's subtree, excluding the flushes of overlapping subtrees.  The
+ * overlapping flushes get the subtree in the order they asked for it.
+ */
+static void cgroup_rstat_flush_lock_subtree(struct cgroup *cgrp)
+{
+	struct cgroup_rstat_flush_waiter waiter = {
+		.cgrp = cgrp,
+		.task = current,
+	};
+
+	might_sleep();
+	lock_map_acquire(&cgroup_rstat_flush_map);
+
+	spin_lock(&cgroup_rstat_flush_lock);
+	list_add_tail(&waiter.node, &cgroup_rstat_flush_waiters);
+	if (!cgroup_rstat_flush_busy(&waiter))
+		cgroup_rstat_flush_grant(&waiter, NULL);
+	spin_unlock(&cgroup_rstat_flush_lock);
+
+	for (;;) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		if (!smp_load_acquire(&waiter.task))
+			break;
+		schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+}
+
+static void cgroup_rstat_flush_unlock_subtree(struct cgroup *cgrp)
+{
+	struct cgroup_rstat_flush_waiter *waiter, *next;
+	DEFINE_WAKE_Q(wake_q);
+
+	spin_lock(&cgroup_rstat_flush_lock);
+	list_del(&cgrp->rstat_flush_node);
+
+	list_for_each_entry_safe(waiter, next, &cgroup_rstat_flush_waiters,
+				 node) {
+		if (cgroup_rstat_flush_overlap(waiter->cgrp, cgrp) &&
+		    !cgroup_rstat_flush_busy(waiter))
+			cgroup_rstat_flush_grant(waiter, &wake_q);
+	}
+	spin_unlock(&cgroup_rstat_flush_lock);
+
+	lock_map_release(&cgroup_rstat_flush_map);
+	wake_up_q(&wake_q);
+}
+
+/*
+ * Whether the stats of @cgrp were flushed less than @max_age jiffies ago,
+ * by a flush of @cgrp or of one of its ancestors.
+ */
+static bool cgroup_rstat_fresh(struct cgroup *cgrp, unsigned long max_age)
+{
+	struct cgroup *pos;
+
+	if (!max_age)
+		return false;
+
+	for (pos = cgrp; pos; pos = cgroup_parent(pos)) {
+		unsigned long flushed = READ_ONCE(pos->rstat_flush_time);
+
+		if (time_before(jiffies, flushed + max_age))
+			return true;
+	}
+
+	return false;
+}
+
+static unsigned long cgroup_rstat_max_staleness(void)
+{
+	return msecs_to_jiffies(READ_ONCE(cgroup_rstat_max_staleness_ms));
+}
+
+/*
+ * Flush @pos on @cpu.  If @pos is the root of the subtree being flushed, its
+ * parent is shared with the flushes of the sibling subtrees.
+ */
+static void cgroup_rstat_flush_one(struct cgroup *pos, int cpu, bool shared)
+{
+	struct cgroup_subsys_state *css;
+
+	if (shared)
+		spin_lock(&cgroup_rstat_base_lock);
+	cgroup_base_stat_flush(pos, cpu);
+	bpf_rstat_flush(pos, cgroup_parent(pos), cpu);
+	if (shared)
+		spin_unlock(&cgroup_rstat_base_lock);
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(css, &pos->rstat_css_list, rstat_css_node) {
+		spinlock_t *ss_lock = &cgroup_rstat_ss_lock[css->ss->id];
+
+		if (shared)
+			spin_lock(ss_lock);
+		css->ss->css_rstat_flush(css, cpu);
+		if (shared)
+			spin_unlock(ss_lock);
+	}
+	rcu_read_unlock();
+}
+
+/* see cgroup_rstat_flush(), called with @cgrp's subtree claimed */
 static void cgroup_rstat_flush_locked(struct cgroup *cgrp)
-	__releases(&cgroup_rstat_lock) __acquires(&cgroup_rstat_lock)
 {
+	unsigned long start = jiffies;
+	bool shared = cgroup_parent(cgrp);
 	int cpu;
 
-	lockdep_assert_held(&cgroup_rstat_lock);
-
 	for_each_possible_cpu(cpu) {
 		struct cgroup *pos = cgroup_rstat_updated_list(cgrp, cpu);
 
-		for (; pos; pos = pos->rstat_flush_next) {
-			struct cgroup_subsys_state *css;
-
-			cgroup_base_stat_flush(pos, cpu);
-			bpf_rstat_flush(pos, cgroup_parent(pos), cpu);
-
-			rcu_read_lock();
-			list_for_each_entry_rcu(css, &pos->rstat_css_list,
-						rstat_css_node)
-				css->ss->css_rstat_flush(css, cpu);
-			rcu_read_unlock();
-		}
+		for (; pos; pos = pos->rstat_flush_next)
+			cgroup_rstat_flush_one(pos, cpu, shared && pos == cgrp);
 
 		/* play nice and yield if necessary */
-		if (need_resched() || spin_needbreak(&cgroup_rstat_lock)) {
-			spin_unlock_irq(&cgroup_rstat_lock);
-			if (!cond_resched())
-				cpu_relax();
-			spin_lock_irq(&cgroup_rstat_lock);
-		}
+		cond_resched();
 	}
+
+	WRITE_ONCE(cgrp->rstat_flush_time, start);
 }
 
 /**
@@ -267,41 +447,67 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp)
  * This also gets all cgroups in the subtree including @cgrp off the
  * ->updated_children lists.
  *
+ * Flushes of disjoint subtrees proceed in parallel, a flush waits for the
+ * flushes of the ancestors and descendants of @cgrp.
+ *
  * This function may block.
  */
 __bpf_kfunc void cgroup_rstat_flush(struct cgroup *cgrp)
 {
-	might_sleep();
-
-	spin_lock_irq(&cgroup_rstat_lock);
+	cgroup_rstat_flush_lock_subtree(cgrp);
 	cgroup_rstat_flush_locked(cgrp);
-	spin_unlock_irq(&cgroup_rstat_lock);
+	cgroup_rstat_flush_unlock_subtree(cgrp);
+}
+
+/**
+ * cgroup_rstat_flush_ratelimited - flush stats in @cgrp's subtree if stale
+ * @cgrp: target cgroup
+ *
+ * Like cgroup_rstat_flush() but skip the flush if @cgrp's stats were flushed
+ * less than cgroup.rstat_max_staleness_ms ago, by a flush of @cgrp or of one
+ * of its ancestors.  For readers which can live with stats that old.
+ *
+ * This function may block.
+ */
+void cgroup_rstat_flush_ratelimited(struct cgroup *cgrp)
+{
+	unsigned long max_age = cgroup_rstat_max_staleness();
+
+	if (cgroup_rstat_fresh(cgrp, max_age))
+		return;
+
+	cgroup_rstat_flush_lock_subtree(cgrp);
+	/* an overlapping flush we waited for may have done the job */
+	if (!cgroup_rstat_fresh(cgrp, max_age))
+		cgroup_rstat_flush_locked(cgrp);
+	cgroup_rstat_flush_unlock_subtree(cgrp);
 }
 
 /**
  * cgroup_rstat_flush_hold - flush stats in @cgrp's subtree and hold
  * @cgrp: target cgroup
  *
- * Flush stats in @cgrp's subtree and prevent further flushes.  Must be
+ * Flush stats in @cgrp's subtree and prevent further flushes of the subtree,
+ * of its ancestors and of its descendants.  The flush is skipped like in
+ * cgroup_rstat_flush_ratelimited() if the stats are recent enough.  Must be
  * paired with cgroup_rstat_flush_release().
  *
  * This function may block.
  */
 void cgroup_rstat_flush_hold(struct cgroup *cgrp)
-	__acquires(&cgroup_rstat_lock)
 {
-	might_sleep();
-	spin_lock_irq(&cgroup_rstat_lock);
-	cgroup_rstat_flush_locked(cgrp);
+	cgroup_rstat_flush_lock_subtree(cgrp);
+	if (!cgroup_rstat_fresh(cgrp, cgroup_rstat_max_staleness()))
+		cgroup_rstat_flush_locked(cgrp);
 }
 
 /**
  * cgroup_rstat_flush_release - release cgroup_rstat_flush_hold()
+ * @cgrp: cgroup passed to cgroup_rstat_flush_hold()
  */
-void cgroup_rstat_flush_release(void)
-	__releases(&cgroup_rstat_lock)
+void cgroup_rstat_flush_release(struct cgroup *cgrp)
 {
-	spin_unlock_irq(&cgroup_rstat_lock);
+	cgroup_rstat_flush_unlock_subtree(cgrp);
 }
 
 int cgroup_rstat_init(struct cgroup *cgrp)
@@ -315,6 +521,10 @@ int cgroup_rstat_init(struct cgroup *cgrp)
 			return -ENOMEM;
 	}
 
+	INIT_LIST_HEAD(&cgrp->rstat_flush_node);
+	/* a new cgroup has no stats older than itself */
+	cgrp->rstat_flush_time = jiffies;
+
 	/* ->updated_children list is self terminated */
 	for_each_possible_cpu(cpu) {
 		struct cgroup_rstat_cpu *rstatc = cgroup_rstat_cpu(cgrp, cpu);
@@ -347,7 +557,10 @@ void cgroup_rstat_exit(struct cgroup *cgrp)
 
 void __init cgroup_rstat_boot(void)
 {
-	int cpu;
+	int cpu, ssid;
+
+	for (ssid = 0; ssid < CGROUP_SUBSYS_COUNT; ssid++)
+		spin_lock_init(&cgroup_rstat_ss_lock[ssid]);
 
 	for_each_possible_cpu(cpu)
 		raw_spin_lock_init(per_cpu_ptr(&cgroup_rstat_cpu_lock, cpu));
@@ -533,7 +746,7 @@ void cgroup_base_stat_cputime_show(struct seq_file *seq)
 #ifdef CONFIG_SCHED_CORE
 		forceidle_time = cgrp->bstat.forceidle_sum;
 #endif
-		cgroup_rstat_flush_release();
+		cgroup_rstat_flush_release(cgrp);
 	} else {
 		root_cgroup_cputime(&bstat);
 		usage = bstat.cputime.sum_exec_runtime;
@@ -920,6 +920,7 @@ void __mmdrop(struct mm_struct *mm)
 	mm_pasid_drop(mm);
 	mm_destroy_cid(mm);
 	percpu_counter_destroy_many(mm->rss_stat, NR_MM_COUNTERS);
+	futex_mm_free(mm);
 
 	free_mm(mm);
 }
@@ -1278,6 +1279,7 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 #endif
 	mm_init_uprobes_state(mm);
 	hugetlb_count_init(mm);
+	futex_mm_init(mm);
 
 	if (current->mm) {
 		mm->flags = mmf_init_flags(current->mm->flags);
@@ -1761,7 +1763,7 @@ static int copy_fs(unsigned long clone_flags, struct task_struct *tsk)
 }
 
 static int copy_files(unsigned long clone_flags, struct task_struct *tsk,
-		      int no_files)
+		      struct kernel_clone_args *args)
 {
 	struct files_struct *oldf, *newf;
 	int error = 0;
@@ -1773,7 +1775,7 @@ static int copy_files(unsigned long clone_flags, struct task_struct *tsk,
 	if (!oldf)
 		goto out;
 
-	if (no_files) {
+	if (args->no_files) {
 		tsk->files = NULL;
 		goto out;
 	}
@@ -1783,7 +1785,15 @@ static int copy_files(unsigned long clone_flags, struct task_struct *tsk,
 		goto out;
 	}
 
-	newf = dup_fd(oldf, NR_OPEN_MAX, &error);
+	/*
+	 * Spawning a program usually only needs a few of the files of the
+	 * parent, which may have a lot of them open.  The clone3() only flags
+	 * don't fit in @clone_flags on 32-bit.
+	 */
+	if (args->flags & CLONE_SELECT_FILES)
+		newf = dup_fd_select(oldf, args->fds, args->fds_size, &error);
+	else
+		newf = dup_fd(oldf, NR_OPEN_MAX, &error);
 	if (!newf)
 		goto out;
 
@@ -2479,7 +2489,7 @@ __latent_entropy struct task_struct *copy_process(
 	retval = copy_semundo(clone_flags, p);
 	if (retval)
 		goto bad_fork_cleanup_security;
-	retval = copy_files(clone_flags, p, args->no_files);
+	retval = copy_files(clone_flags, p, args);
 	if (retval)
 		goto bad_fork_cleanup_semundo;
 	retval = copy_fs(clone_flags, p);
@@ -3059,7 +3069,9 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 		     CLONE_ARGS_SIZE_VER1);
 	BUILD_BUG_ON(offsetofend(struct clone_args, cgroup) !=
 		     CLONE_ARGS_SIZE_VER2);
-	BUILD_BUG_ON(sizeof(struct clone_args) != CLONE_ARGS_SIZE_VER2);
+	BUILD_BUG_ON(offsetofend(struct clone_args, fds_size) !=
+		     CLONE_ARGS_SIZE_VER3);
+	BUILD_BUG_ON(sizeof(struct clone_args) != CLONE_ARGS_SIZE_VER3);
 
 	if (unlikely(usize > PAGE_SIZE))
 		return -E2BIG;
@@ -3091,6 +3103,15 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 	    (args.cgroup > INT_MAX || usize < CLONE_ARGS_SIZE_VER2))
 		return -EINVAL;
 
+	if (args.flags & CLONE_SELECT_FILES) {
+		if (usize < CLONE_ARGS_SIZE_VER3 ||
+		    args.fds_size > sysctl_nr_open ||
+		    (!args.fds && args.fds_size > 0))
+			return -EINVAL;
+	} else if (args.fds || args.fds_size) {
+		return -EINVAL;
+	}
+
 	*kargs = (struct kernel_clone_args){
 		.flags		= args.flags,
 		.pidfd		= u64_to_user_ptr(args.pidfd),
@@ -3102,6 +3123,7 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 		.tls		= args.tls,
 		.set_tid_size	= args.set_tid_size,
 		.cgroup		= args.cgroup,
+		.fds_size	= args.fds_size,
 	};
 
 	if (args.set_tid &&
@@ -3111,6 +3133,16 @@ noinline static int copy_clone_args_from_user(struct kernel_clone_args *kargs,
 
 	kargs->set_tid = kset_tid;
 
+	if (args.fds_size) {
+		kargs->fds = vmemdup_array_user(u64_to_user_ptr(args.fds),
+						args.fds_size, sizeof(*kargs->fds));
+		if (IS_ERR(kargs->fds)) {
+			err = PTR_ERR(kargs->fds);
+			kargs->fds = NULL;
+			return err;
+		}
+	}
+
 	return 0;
 }
 
@@ -3146,7 +3178,8 @@ static bool clone3_args_valid(struct kernel_clone_args *kargs)
 {
 	/* Verify that no unknown flags are passed along. */
 	if (kargs->flags &
-	    ~(CLONE_LEGACY_FLAGS | CLONE_CLEAR_SIGHAND | CLONE_INTO_CGROUP))
+	    ~(CLONE_LEGACY_FLAGS | CLONE_CLEAR_SIGHAND | CLONE_INTO_CGROUP |
+	      CLONE_SELECT_FILES))
 		return false;
 
 	/*
@@ -3160,6 +3193,10 @@ static bool clone3_args_valid(struct kernel_clone_args *kargs)
 	    (CLONE_SIGHAND | CLONE_CLEAR_SIGHAND))
 		return false;
 
+	if ((kargs->flags & (CLONE_FILES | CLONE_SELECT_FILES)) ==
+	    (CLONE_FILES | CLONE_SELECT_FILES))
+		return false;
+
 	if ((kargs->flags & (CLONE_THREAD | CLONE_PARENT)) &&
 	    kargs->exit_signal)
 		return false;
@@ -3194,10 +3231,13 @@ SYSCALL_DEFINE2(clone3, struct clone_args __user *, uargs, size_t, size)
 	if (err)
 		return err;
 
-	if (!clone3_args_valid(&kargs))
-		return -EINVAL;
+	if (clone3_args_valid(&kargs))
+		err = kernel_clone(&kargs);
+	else
+		err = -EINVAL;
 
-	return kernel_clone(&kargs);
+	kvfree(kargs.fds);
+	return err;
 }
 #endif
 
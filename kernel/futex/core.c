@@ -37,21 +37,46 @@
 #include <linux/memblock.h>
 #include <linux/fault-inject.h>
 #include <linux/slab.h>
+#include <linux/sched/signal.h>
+#include <linux/sysctl.h>
 
 #include "futex.h"
 #include "../locking/rtmutex_common.h"
 
 /*
- * The base of the bucket array and its size are always used together
- * (after initialization only in futex_hash()), so ensure that they
- * reside in the same cacheline.
+ * The global hash is split in one bucket array per node, each allocated on
+ * its node. The size of the arrays and their bases are always used together
+ * (after initialization only in futex_hash()). The bases take up to 8KB with
+ * the largest MAX_NUMNODES, so the size comes first, where it shares a
+ * cacheline with the bases of the first nodes.
  */
 static struct {
-	struct futex_hash_bucket *queues;
-	unsigned long            hashsize;
-} __futex_data __read_mostly __aligned(2*sizeof(long));
-#define futex_queues   (__futex_data.queues)
-#define futex_hashsize (__futex_data.hashsize)
+	unsigned long            hashmask;
+	unsigned int		 hashshift;
+	struct futex_hash_bucket *queues[MAX_NUMNODES];
+} __futex_data __read_mostly ____cacheline_aligned;
+#define futex_queues    (__futex_data.queues)
+#define futex_hashmask  (__futex_data.hashmask)
+#define futex_hashshift (__futex_data.hashshift)
+
+/*
+ * Private futexes of a process only ever match futexes of that same process,
+ * so they can be hashed in a table of its own instead of sharing the buckets
+ * (and their locks) with every other process of the machine.
+ */
+struct futex_private_hash {
+	unsigned int		 hashmask;
+	struct rcu_head		 rcu;
+	struct futex_hash_bucket queues[];
+};
+
+/* mm->futex_phash of processes using the global hash for private futexes */
+#define FUTEX_PHASH_GLOBAL	((struct futex_private_hash *)1UL)
+
+#define FUTEX_PHASH_MIN		16
+#define FUTEX_PHASH_MAX		4096
+
+static unsigned int futex_private_hash_enabled __read_mostly;
 
 
 /*
@@ -105,19 +130,108 @@ late_initcall(fail_futex_debugfs);
 
 #endif /* CONFIG_FAIL_FUTEX */
 
+static void futex_init_buckets(struct futex_hash_bucket *queues,
+			       unsigned long nr)
+{
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		atomic_set(&queues[i].waiters, 0);
+		plist_head_init(&queues[i].chain);
+		spin_lock_init(&queues[i].lock);
+	}
+}
+
+/*
+ * Decide, once and for all, where the private futexes of @mm are hashed:
+ * switching tables while futexes are queued would lose their wakeups. The
+ * private table is sized from the number of threads at that point, and
+ * stays with the mm until it is freed; a child gets its own at its first
+ * futex operation.
+ */
+static void futex_private_hash_init(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph = FUTEX_PHASH_GLOBAL;
+	unsigned int nr;
+
+	if (READ_ONCE(futex_private_hash_enabled)) {
+		nr = 4 * max_t(unsigned int, get_nr_threads(current),
+			       num_online_cpus());
+		nr = clamp(roundup_pow_of_two(nr), FUTEX_PHASH_MIN,
+			   FUTEX_PHASH_MAX);
+
+		fph = kvzalloc_node(struct_size(fph, queues, nr),
+				    GFP_KERNEL_ACCOUNT, numa_node_id());
+		if (fph) {
+			fph->hashmask = nr - 1;
+			futex_init_buckets(fph->queues, nr);
+		} else {
+			fph = FUTEX_PHASH_GLOBAL;
+		}
+	}
+
+	if (cmpxchg(&mm->futex_phash, NULL, fph) && fph != FUTEX_PHASH_GLOBAL)
+		kvfree(fph);
+}
+
+static inline struct futex_private_hash *futex_private_hash(union futex_key *key)
+{
+	struct futex_private_hash *fph;
+
+	if (!IS_ENABLED(CONFIG_MMU) ||
+	    (key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED)))
+		return NULL;
+
+	fph = READ_ONCE(key->private.mm->futex_phash);
+	if (fph == FUTEX_PHASH_GLOBAL)
+		return NULL;
+
+	return fph;
+}
+
+void futex_mm_init(struct mm_struct *mm)
+{
+	mm->futex_phash = NULL;
+}
+
+/*
+ * Called from __mmdrop(), which can run with preemption disabled from
+ * finish_task_switch(), where the vfree() of a large table can't sleep.
+ */
+void futex_mm_free(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph = mm->futex_phash;
+
+	if (fph && fph != FUTEX_PHASH_GLOBAL)
+		kvfree_rcu(fph, rcu);
+}
+
 /**
- * futex_hash - Return the hash bucket in the global hash
+ * futex_hash - Return the hash bucket of a futex
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket: in the private hash of the process for private
+ * futexes if it has one, otherwise in the global hash of the futex's node.
+ * Futexes without a node are spread over all the nodes.
  */
 struct futex_hash_bucket *futex_hash(union futex_key *key)
 {
+	struct futex_private_hash *fph = futex_private_hash(key);
 	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
 			  key->both.offset);
+	int node = key->both.node;
 
-	return &futex_queues[hash & (futex_hashsize - 1)];
+	if (fph)
+		return &fph->queues[hash & fph->hashmask];
+
+	if (node == FUTEX_NO_NODE) {
+		node = (hash >> futex_hashshift) % nr_node_ids;
+		if (!node_possible(node))
+			node = next_node_in(node, node_possible_map);
+	}
+
+	return &futex_queues[node][hash & futex_hashmask];
 }
 
 
@@ -190,6 +304,58 @@ static u64 get_inode_sequence_number(struct inode *inode)
 	}
 }
 
+/*
+ * A FUTEX2_NUMA futex is followed by its node, and the pair must be naturally
+ * aligned so that it never straddles a page.
+ */
+static inline unsigned int futex_key_size(unsigned int flags)
+{
+	if (flags & FLAGS_NUMA)
+		return 2 * futex_size(flags);
+
+	return futex_size(flags);
+}
+
+/*
+ * Read the node of a FUTEX2_NUMA futex; if it has none yet, give it the node
+ * of the current task, unless another task raced with us. Through a read-only
+ * mapping the node can't be given: fail rather than hash the futex without
+ * node, as a task with a writable alias would hash it with its node and the
+ * two would never meet.
+ */
+static int futex_get_node(u32 __user *naddr, int *node)
+{
+	u32 val, cur;
+	int ret;
+
+again:
+	if (get_user(val, naddr))
+		return -EFAULT;
+
+	if ((int)val == FUTEX_NO_NODE) {
+		val = numa_node_id();
+
+		pagefault_disable();
+		ret = futex_cmpxchg_value_locked(&cur, naddr, FUTEX_NO_NODE, val);
+		pagefault_enable();
+		if (ret == -EFAULT) {
+			if (fault_in_user_writeable(naddr))
+				return -EFAULT;
+			goto again;
+		}
+		if (ret)
+			return ret;
+		if ((int)cur != FUTEX_NO_NODE)
+			val = cur;
+	}
+
+	if (val >= MAX_NUMNODES || !node_possible(val))
+		return -EINVAL;
+
+	*node = val;
+	return 0;
+}
+
 /**
  * get_futex_key() - Get parameters which are the keys for a futex
  * @uaddr:	virtual address of the futex
@@ -234,16 +400,23 @@ int get_futex_key(u32 __user *uaddr, unsigned int flags, union futex_key *key,
 	 * The futex address must be "naturally" aligned.
 	 */
 	key->both.offset = address % PAGE_SIZE;
-	if (unlikely((address % sizeof(u32)) != 0))
+	if (unlikely((address % futex_key_size(flags)) != 0))
 		return -EINVAL;
 	address -= key->both.offset;
 
-	if (unlikely(!access_ok(uaddr, sizeof(u32))))
+	if (unlikely(!access_ok(uaddr, futex_key_size(flags))))
 		return -EFAULT;
 
 	if (unlikely(should_fail_futex(fshared)))
 		return -EFAULT;
 
+	key->both.node = FUTEX_NO_NODE;
+	if (flags & FLAGS_NUMA) {
+		err = futex_get_node(uaddr + 1, &key->both.node);
+		if (err)
+			return err;
+	}
+
 	/*
 	 * PROCESS_PRIVATE futexes are fast.
 	 * As the mm cannot disappear under us and the 'key' only needs
@@ -258,10 +431,13 @@ int get_futex_key(u32 __user *uaddr, unsigned int flags, union futex_key *key,
 		 * there is only one address space, the address is a unique key
 		 * on its own.
 		 */
-		if (IS_ENABLED(CONFIG_MMU))
+		if (IS_ENABLED(CONFIG_MMU)) {
 			key->private.mm = mm;
-		else
+			if (unlikely(!READ_ONCE(mm->futex_phash)))
+				futex_private_hash_init(mm);
+		} else {
 			key->private.mm = NULL;
+		}
 
 		key->private.address = address;
 		return 0;
@@ -1135,29 +1311,50 @@ void futex_exit_release(struct task_struct *tsk)
 	futex_cleanup_end(tsk, FUTEX_STATE_DEAD);
 }
 
+#ifdef CONFIG_SYSCTL
+static struct ctl_table futex_sysctls[] = {
+	{
+		.procname	= "futex_private_hash",
+		.data		= &futex_private_hash_enabled,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+};
+#endif
+
 static int __init futex_init(void)
 {
-	unsigned int futex_shift;
-	unsigned long i;
+	unsigned long hashsize;
+	int node;
 
 #if CONFIG_BASE_SMALL
-	futex_hashsize = 16;
+	hashsize = 16;
 #else
-	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+	hashsize = 256 * num_possible_cpus() / num_possible_nodes();
+	hashsize = roundup_pow_of_two(max(hashsize, 4UL));
 #endif
+	futex_hashmask = hashsize - 1;
+	futex_hashshift = ilog2(hashsize);
+
+	for_each_node(node) {
+		struct futex_hash_bucket *queues;
 
-	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
-					       futex_hashsize, 0, 0,
-					       &futex_shift, NULL,
-					       futex_hashsize, futex_hashsize);
-	futex_hashsize = 1UL << futex_shift;
+		queues = kvzalloc_node(hashsize * sizeof(*queues), GFP_KERNEL,
+				       node_state(node, N_MEMORY) ? node : NUMA_NO_NODE);
+		if (!queues)
+			panic("futex: failed to allocate the hash of node %d\n", node);
 
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
+		futex_init_buckets(queues, hashsize);
+		futex_queues[node] = queues;
 	}
 
+#ifdef CONFIG_SYSCTL
+	register_sysctl_init("kernel", futex_sysctls);
+#endif
+
 	return 0;
 }
 core_initcall(futex_init);
@@ -378,7 +378,7 @@ SYSCALL_DEFINE6(futex_wait,
 	struct hrtimer_sleeper to;
 	int ret;
 
-	if (flags & ~FUTEX2_VALID_MASK)
+	if (flags & ~(FUTEX2_VALID_MASK | FUTEX2_SPIN))
 		return -EINVAL;
 
 	flags = futex2_to_flags(flags);
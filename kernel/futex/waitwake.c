@@ -2,6 +2,7 @@
 
 #include <linux/sched/task.h>
 #include <linux/sched/signal.h>
+#include <linux/sched/clock.h>
 #include <linux/freezer.h>
 
 #include "futex.h"
@@ -643,6 +644,113 @@ int futex_wait_setup(u32 __user *uaddr, u32 val, unsigned int flags,
 	return ret;
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Upper bound of a FUTEX2_SPIN spin: an owner running longer than this is
+ * not about to release the lock, and the waiter's CPU is better used by
+ * something else.
+ */
+#define FUTEX_SPIN_MAX_NS	(50 * NSEC_PER_USEC)
+
+/*
+ * futex_spin_on_owner() - Spin while the owner of the futex is running
+ * @uaddr:	the futex userspace address
+ * @val:	the expected value, with the owner TID in FUTEX_TID_MASK
+ * @to:		the timeout of the wait, if any
+ *
+ * FUTEX2_SPIN waiters follow the PI futex convention of storing the TID of
+ * the lock owner in the futex word. While that task is running on a CPU,
+ * the lock is likely to be released soon, so keep polling the futex word
+ * rather than going through a sleep and a wakeup, similar to
+ * mutex_spin_on_owner(). Give up as soon as the owner is off CPU or its
+ * vCPU is preempted, when this task should yield the CPU, or after
+ * FUTEX_SPIN_MAX_NS.
+ *
+ * Return:
+ *  -  0 - stop spinning, go to sleep
+ *  - <0 - -EWOULDBLOCK (uaddr does not contain val anymore), -ETIMEDOUT
+ *	   or -EFAULT
+ */
+static int futex_spin_on_owner(u32 __user *uaddr, u32 val,
+			       struct hrtimer_sleeper *to)
+{
+	pid_t tid = val & FUTEX_TID_MASK;
+	struct task_struct *owner;
+	u64 spin_end;
+	int loop = 0;
+	int ret = 0;
+	u32 uval;
+
+	if (!tid)
+		return 0;
+
+	/* Fault the word in and check the address once */
+	if (get_user(uval, uaddr))
+		return -EFAULT;
+	if (uval != val)
+		return -EWOULDBLOCK;
+
+	rcu_read_lock();
+	owner = find_task_by_vpid(tid);
+	if (owner)
+		get_task_struct(owner);
+	rcu_read_unlock();
+
+	if (!owner || owner == current)
+		goto out;
+
+	spin_end = local_clock() + FUTEX_SPIN_MAX_NS;
+
+	for (;;) {
+		if (!owner_on_cpu(owner) || need_resched() ||
+		    signal_pending(current))
+			break;
+
+		/*
+		 * Check the clocks once every 16 iterations only, as
+		 * rwsem_optimistic_spin() does, to notice a release early.
+		 */
+		if (!(++loop & 0xf)) {
+			if (local_clock() > spin_end)
+				break;
+
+			/* The timer is only started once queued */
+			if (to && hrtimer_expires_remaining(&to->timer) <= 0) {
+				ret = -ETIMEDOUT;
+				break;
+			}
+		}
+
+		cpu_relax();
+
+		/*
+		 * A plain load without fault handling: should the page be
+		 * gone, stop spinning and let futex_wait_setup() fault it in.
+		 */
+		if (futex_get_value_locked(&uval, uaddr))
+			break;
+
+		if (uval != val) {
+			ret = -EWOULDBLOCK;
+			break;
+		}
+	}
+
+out:
+	if (owner)
+		put_task_struct(owner);
+
+	return ret;
+}
+#else
+/* The owner can't run while we spin */
+static inline int futex_spin_on_owner(u32 __user *uaddr, u32 val,
+				      struct hrtimer_sleeper *to)
+{
+	return 0;
+}
+#endif /* CONFIG_SMP */
+
 int __futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 		 struct hrtimer_sleeper *to, u32 bitset)
 {
@@ -655,6 +763,12 @@ int __futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 
 	q.bitset = bitset;
 
+	if (flags & FLAGS_SPIN) {
+		ret = futex_spin_on_owner(uaddr, val, to);
+		if (ret)
+			return ret;
+	}
+
 retry:
 	/*
 	 * Prepare to wait on uaddr. On success, it holds hb->lock and q
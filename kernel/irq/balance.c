@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * In-kernel balancing of interrupt affinities.
+ *
+ * While enabled, the time spent in the hard interrupt handlers is accounted
+ * per interrupt and per CPU. Every irq_balance.interval_ms the balancer looks
+ * for the CPU which spent the largest share of the interval in handlers. When
+ * that share is above irq_balance.threshold percent, the hottest interrupt
+ * targeting only that CPU is moved to the CPU which spent the least time in
+ * handlers, on the node of the interrupt if possible, provided that the move
+ * lowers the load of the busiest CPU. At most one interrupt is moved per pass
+ * so that the effect of a move is measured before the next one.
+ *
+ * Only interrupts whose affinity user space could change are balanced, and
+ * only while nobody but the balancer set their affinity: IRQD_AFFINITY_SET,
+ * set when user space or a driver sets an affinity, is cleared again after a
+ * move of the balancer. Interrupts are moved among the online CPUs of
+ * irq_default_affinity. When the target CPU can't take an interrupt, e.g.
+ * because the vector space of the CPU is exhausted, the interrupt stays where
+ * it is. Disabling the balancer gives the interrupts it moved their default
+ * affinity back.
+ */
+#define pr_fmt(fmt) "irq_balance: " fmt
+
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+#undef MODULE_PARAM_PREFIX
+#define MODULE_PARAM_PREFIX "irq_balance."
+
+DEFINE_STATIC_KEY_FALSE(irq_balance_enabled);
+
+DEFINE_PER_CPU(u64, irq_balance_cpu_ns);
+
+/* Handler time of the CPUs at the previous pass and since then */
+static DEFINE_PER_CPU(u64, irq_balance_cpu_prev_ns);
+static DEFINE_PER_CPU(u64, irq_balance_cpu_load);
+
+static bool irq_balance_enable;
+static unsigned int irq_balance_interval_ms = 10;
+static unsigned int irq_balance_threshold = 20;
+
+module_param_named(interval_ms, irq_balance_interval_ms, uint, 0644);
+MODULE_PARM_DESC(interval_ms, "Interval between two balancing passes");
+module_param_named(threshold, irq_balance_threshold, uint, 0644);
+MODULE_PARM_DESC(threshold, "Share of a CPU spent in interrupt handlers, in percent, above which interrupts are moved away");
+
+/* Protects the state of the balancer against concurrent enable writes */
+static DEFINE_MUTEX(irq_balance_mutex);
+/* Set once the balancer can run, the enable parameter is only stored before */
+static bool irq_balance_ready;
+/* local_clock() of the previous pass */
+static u64 irq_balance_last_pass;
+/* Least loaded CPU of every node in the current pass */
+static int *irq_balance_node_coolest;
+
+static void irq_balance_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_workfn);
+
+static void irq_balance_queue(void)
+{
+	unsigned int interval = max(READ_ONCE(irq_balance_interval_ms), 1U);
+
+	queue_delayed_work(system_unbound_wq, &irq_balance_work,
+			   msecs_to_jiffies(interval));
+}
+
+/*
+ * Whether @desc only targets @cpu and has an affinity the balancer may
+ * change.
+ */
+static bool irq_balance_movable(struct irq_desc *desc, int cpu)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	bool ret;
+
+	if (!irq_can_set_affinity_usr(irq_desc_get_irq(desc)))
+		return false;
+
+	raw_spin_lock_irq(&desc->lock);
+	ret = desc->action && !irqd_has_set(data, IRQD_AFFINITY_SET) &&
+	      cpumask_equal(irq_data_get_effective_affinity_mask(data),
+			    cpumask_of(cpu));
+	raw_spin_unlock_irq(&desc->lock);
+
+	return ret;
+}
+
+/*
+ * Pick the CPU to move @desc with a load of @load to, away from a CPU with a
+ * load of @busiest_load. Returns -1 if no move lowers the load of the busiest
+ * CPU.
+ */
+static int irq_balance_target(struct irq_desc *desc, u64 load,
+			      u64 busiest_load, int coolest)
+{
+	int node = irq_desc_get_node(desc);
+	int cpu;
+
+	if (node != NUMA_NO_NODE) {
+		cpu = irq_balance_node_coolest[node];
+		if (cpu >= 0 && per_cpu(irq_balance_cpu_load, cpu) + load < busiest_load)
+			return cpu;
+	}
+
+	if (coolest >= 0 && per_cpu(irq_balance_cpu_load, coolest) + load < busiest_load)
+		return coolest;
+
+	return -1;
+}
+
+static void irq_balance_move(unsigned int irq, int cpu)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	int ret;
+
+	raw_spin_lock_irq(&desc->lock);
+	/* User space or a driver may have set an affinity meanwhile */
+	if (irqd_has_set(data, IRQD_AFFINITY_SET)) {
+		raw_spin_unlock_irq(&desc->lock);
+		return;
+	}
+	ret = irq_set_affinity_locked(data, cpumask_of(cpu), false);
+	/* Not an affinity to preserve, the interrupt stays balanced */
+	irqd_clear(data, IRQD_AFFINITY_SET);
+	/* Only the balancer looks at ->balance_cpu */
+	if (!ret)
+		desc->balance_cpu = cpu;
+	raw_spin_unlock_irq(&desc->lock);
+
+	if (ret)
+		pr_debug("moving IRQ %u to CPU %d failed: %d\n", irq, cpu, ret);
+}
+
+/*
+ * Give the interrupts the balancer moved, and whose affinity nobody set
+ * since, their default affinity back.
+ */
+static void irq_balance_restore(void)
+{
+	unsigned int irq;
+
+	irq_lock_sparse();
+	for_each_active_irq(irq) {
+		struct irq_desc *desc = irq_to_desc(irq);
+
+		if (!desc || desc->balance_cpu < 0)
+			continue;
+
+		raw_spin_lock_irq(&desc->lock);
+		if (!irqd_has_set(&desc->irq_data, IRQD_AFFINITY_SET))
+			irq_setup_affinity(desc);
+		desc->balance_cpu = -1;
+		raw_spin_unlock_irq(&desc->lock);
+	}
+	irq_unlock_sparse();
+}
+
+static void irq_balance_workfn(struct work_struct *work)
+{
+	u64 now = local_clock(), interval = now - irq_balance_last_pass;
+	u64 busiest_load = 0, best_load = 0;
+	int busiest = -1, coolest = -1, best_target = -1;
+	unsigned int irq, best_irq = 0;
+	bool overloaded;
+	int cpu, node;
+
+	irq_balance_last_pass = now;
+
+	for_each_online_cpu(cpu) {
+		u64 ns = READ_ONCE(per_cpu(irq_balance_cpu_ns, cpu));
+
+		per_cpu(irq_balance_cpu_load, cpu) =
+			ns - per_cpu(irq_balance_cpu_prev_ns, cpu);
+		per_cpu(irq_balance_cpu_prev_ns, cpu) = ns;
+	}
+
+	for (node = 0; node < nr_node_ids; node++)
+		irq_balance_node_coolest[node] = -1;
+
+	for_each_cpu_and(cpu, cpu_online_mask, irq_default_affinity) {
+		u64 load = per_cpu(irq_balance_cpu_load, cpu);
+		int *node_coolest = &irq_balance_node_coolest[cpu_to_node(cpu)];
+
+		if (busiest < 0 || load > busiest_load) {
+			busiest = cpu;
+			busiest_load = load;
+		}
+		if (coolest < 0 || load < per_cpu(irq_balance_cpu_load, coolest))
+			coolest = cpu;
+		if (*node_coolest < 0 ||
+		    load < per_cpu(irq_balance_cpu_load, *node_coolest))
+			*node_coolest = cpu;
+	}
+
+	overloaded = busiest >= 0 &&
+		     busiest_load * 100 > interval * READ_ONCE(irq_balance_threshold);
+
+	irq_lock_sparse();
+	for_each_active_irq(irq) {
+		struct irq_desc *desc = irq_to_desc(irq);
+		u64 ns, load;
+		int target;
+
+		if (!desc)
+			continue;
+
+		/* Always advance the per interrupt sample */
+		ns = READ_ONCE(desc->balance_ns);
+		load = ns - desc->balance_prev_ns;
+		desc->balance_prev_ns = ns;
+
+		if (!overloaded || load <= best_load)
+			continue;
+
+		target = irq_balance_target(desc, load, busiest_load, coolest);
+		if (target < 0 || target == busiest)
+			continue;
+
+		if (!irq_balance_movable(desc, busiest))
+			continue;
+
+		best_irq = irq;
+		best_target = target;
+		best_load = load;
+	}
+
+	if (best_target >= 0)
+		irq_balance_move(best_irq, best_target);
+	irq_unlock_sparse();
+
+	irq_balance_queue();
+}
+
+/* Called with irq_balance_mutex held */
+static void irq_balance_apply(void)
+{
+	if (irq_balance_enable == static_key_enabled(&irq_balance_enabled))
+		return;
+
+	if (irq_balance_enable) {
+		static_branch_enable(&irq_balance_enabled);
+		irq_balance_last_pass = local_clock();
+		irq_balance_queue();
+		pr_info("enabled\n");
+	} else {
+		static_branch_disable(&irq_balance_enabled);
+		cancel_delayed_work_sync(&irq_balance_work);
+		irq_balance_restore();
+		pr_info("disabled\n");
+	}
+}
+
+static int irq_balance_enable_set(const char *val, const struct kernel_param *kp)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(val, &enable);
+	if (ret)
+		return ret;
+
+	/* Early boot, irq_balance_init() applies it */
+	if (!irq_balance_ready) {
+		irq_balance_enable = enable;
+		return 0;
+	}
+
+	mutex_lock(&irq_balance_mutex);
+	irq_balance_enable = enable;
+	irq_balance_apply();
+	mutex_unlock(&irq_balance_mutex);
+
+	return 0;
+}
+
+static const struct kernel_param_ops irq_balance_enable_ops = {
+	.set	= irq_balance_enable_set,
+	.get	= param_get_bool,
+};
+module_param_cb(enable, &irq_balance_enable_ops, &irq_balance_enable, 0644);
+MODULE_PARM_DESC(enable, "Balance the affinity of interrupts in the kernel");
+
+static int __init irq_balance_init(void)
+{
+	irq_balance_node_coolest = kcalloc(nr_node_ids,
+					   sizeof(*irq_balance_node_coolest),
+					   GFP_KERNEL);
+	if (!irq_balance_node_coolest)
+		return -ENOMEM;
+
+	mutex_lock(&irq_balance_mutex);
+	irq_balance_ready = true;
+	irq_balance_apply();
+	mutex_unlock(&irq_balance_mutex);
+
+	return 0;
+}
+late_initcall(irq_balance_init);
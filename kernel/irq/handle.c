@@ -188,9 +188,11 @@ irqreturn_t __handle_irq_event_percpu(struct irq_desc *desc)
 
 irqreturn_t handle_irq_event_percpu(struct irq_desc *desc)
 {
+	u64 start = irq_balance_start();
 	irqreturn_t retval;
 
 	retval = __handle_irq_event_percpu(desc);
+	irq_balance_account(desc, start);
 
 	add_interrupt_randomness(desc->irq_data.irq);
 
@@ -400,6 +400,39 @@ static inline void record_irq_time(struct irq_desc *desc) {}
 #endif /* CONFIG_IRQ_TIMINGS */
 
 
+#ifdef CONFIG_IRQ_BALANCE
+DECLARE_STATIC_KEY_FALSE(irq_balance_enabled);
+DECLARE_PER_CPU(u64, irq_balance_cpu_ns);
+
+/*
+ * Account the time spent in the handlers of @desc for the in-kernel
+ * balancer. IRQD_IRQ_INPROGRESS serializes the handling of an interrupt, so
+ * only one CPU at a time updates ->balance_ns.
+ */
+static __always_inline u64 irq_balance_start(void)
+{
+	if (!static_branch_unlikely(&irq_balance_enabled))
+		return 0;
+
+	return local_clock();
+}
+
+static __always_inline void irq_balance_account(struct irq_desc *desc, u64 start)
+{
+	u64 delta;
+
+	if (!static_branch_unlikely(&irq_balance_enabled) || !start)
+		return;
+
+	delta = local_clock() - start;
+	WRITE_ONCE(desc->balance_ns, desc->balance_ns + delta);
+	__this_cpu_add(irq_balance_cpu_ns, delta);
+}
+#else
+static inline u64 irq_balance_start(void) { return 0; }
+static inline void irq_balance_account(struct irq_desc *desc, u64 start) { }
+#endif /* CONFIG_IRQ_BALANCE */
+
 #ifdef CONFIG_GENERIC_IRQ_CHIP
 void irq_init_generic_chip(struct irq_chip_generic *gc, const char *name,
 			   int num_ct, unsigned int irq_base,
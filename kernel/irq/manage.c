@@ -1218,6 +1218,40 @@ static irqreturn_t irq_thread_fn(struct irq_desc *desc,
 	return ret;
 }
 
+/*
+ * Maximum number of consecutive thread_fn calls of an IRQF_THREAD_POLL
+ * thread before the line is unmasked again.
+ */
+#define IRQ_THREAD_POLL_BUDGET	64
+
+/*
+ * Interrupts requested with IRQF_THREAD_POLL: keep the line masked and call
+ * thread_fn as long as it finds events to handle, so that a burst of events
+ * costs one interrupt and one thread wakeup. The thread runs with a real-time
+ * policy and would starve everything else on the CPU if it polled forever:
+ * once the budget is spent, the line is unmasked and a device which still
+ * has events pending raises the next interrupt right away.
+ */
+static irqreturn_t irq_thread_poll_fn(struct irq_desc *desc,
+		struct irqaction *action)
+{
+	irqreturn_t ret = IRQ_NONE;
+	int budget = IRQ_THREAD_POLL_BUDGET;
+
+	while (budget--) {
+		if (action->thread_fn(action->irq, action->dev_id) != IRQ_HANDLED)
+			break;
+		ret = IRQ_HANDLED;
+		cond_resched();
+	}
+
+	if (ret == IRQ_HANDLED)
+		atomic_inc(&desc->threads_handled);
+
+	irq_finalize_oneshot(desc, action);
+	return ret;
+}
+
 void wake_threads_waitq(struct irq_desc *desc)
 {
 	if (atomic_dec_and_test(&desc->threads_active))
@@ -1306,6 +1340,8 @@ static int irq_thread(void *data)
 	if (force_irqthreads() && test_bit(IRQTF_FORCED_THREAD,
 					   &action->thread_flags))
 		handler_fn = irq_forced_thread_fn;
+	else if (action->flags & IRQF_THREAD_POLL)
+		handler_fn = irq_thread_poll_fn;
 	else
 		handler_fn = irq_thread_fn;
 
@@ -1530,6 +1566,19 @@ __setup_irq(unsigned int irq, struct irq_desc *desc, struct irqaction *new)
 	 * thread.
 	 */
 	nested = irq_settings_is_nested_thread(desc);
+
+	/*
+	 * A polling handler needs a thread of its own and the line masked
+	 * while it polls.
+	 */
+	if (new->flags & IRQF_THREAD_POLL) {
+		if (!new->thread_fn || nested) {
+			ret = -EINVAL;
+			goto out_mput;
+		}
+		new->flags |= IRQF_ONESHOT;
+	}
+
 	if (nested) {
 		if (!new->thread_fn) {
 			ret = -EINVAL;
@@ -1572,9 +1621,11 @@ __setup_irq(unsigned int irq, struct irq_desc *desc, struct irqaction *new)
 	 * requires the ONESHOT flag to be set. Some irq chips like
 	 * MSI based interrupts are per se one shot safe. Check the
 	 * chip flags, so we can avoid the unmask dance at the end of
-	 * the threaded handler for those.
+	 * the threaded handler for those. A polling thread relies on the
+	 * line being masked, though.
 	 */
-	if (desc->irq_data.chip->flags & IRQCHIP_ONESHOT_SAFE)
+	if ((desc->irq_data.chip->flags & IRQCHIP_ONESHOT_SAFE) &&
+	    !(new->flags & IRQF_THREAD_POLL))
 		new->flags &= ~IRQF_ONESHOT;
 
 	/*
@@ -2137,6 +2188,8 @@ const void *free_nmi(unsigned int irq, void *dev_id)
  *	IRQF_SHARED		Interrupt is shared
  *	IRQF_TRIGGER_*		Specify active edge(s) or level
  *	IRQF_ONESHOT		Run thread_fn with interrupt line masked
+ *	IRQF_THREAD_POLL	Call thread_fn with the line masked until it
+ *				returns IRQ_NONE
  */
 int request_threaded_irq(unsigned int irq, irq_handler_t handler,
 			 irq_handler_t thread_fn, unsigned long irqflags,
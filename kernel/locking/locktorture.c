@@ -114,10 +114,13 @@ static struct task_struct **reader_tasks;
 static bool lock_is_write_held;
 static atomic_t lock_is_read_held;
 static unsigned long last_lock_release;
+static int last_lock_node = NUMA_NO_NODE;
 
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
+	long n_lock_intra_node; /* write acquisitions after a holder of the same node */
+	long n_lock_inter_node; /* write acquisitions after a holder of another node */
 };
 
 struct call_rcu_chain {
@@ -889,6 +892,11 @@ static int lock_torture_writer(void *arg)
 					  __func__, j1 - j);
 			}
 			lwsp->n_lock_acquired++;
+			if (last_lock_node == numa_node_id())
+				lwsp->n_lock_intra_node++;
+			else if (last_lock_node != NUMA_NO_NODE)
+				lwsp->n_lock_inter_node++;
+			last_lock_node = numa_node_id();
 
 			cxt.cur_ops->write_delay(&rand);
 
@@ -950,7 +958,7 @@ static void __torture_print_stats(char *page,
 	bool fail = false;
 	int i, n_stress;
 	long max = 0, min = statp ? data_race(statp[0].n_lock_acquired) : 0;
-	long long sum = 0;
+	long long sum = 0, intra = 0, inter = 0;
 
 	n_stress = write ? cxt.nrealwriters_stress : cxt.nrealreaders_stress;
 	for (i = 0; i < n_stress; i++) {
@@ -958,6 +966,8 @@ static void __torture_print_stats(char *page,
 			fail = true;
 		cur = data_race(statp[i].n_lock_acquired);
 		sum += cur;
+		intra += data_race(statp[i].n_lock_intra_node);
+		inter += data_race(statp[i].n_lock_inter_node);
 		if (max < cur)
 			max = cur;
 		if (min > cur)
@@ -969,6 +979,9 @@ static void __torture_print_stats(char *page,
 			sum, max, min,
 			!onoff_interval && max / 2 > min ? "???" : "",
 			fail, fail ? "!!!" : "");
+	if (write && nr_online_nodes > 1)
+		page += sprintf(page, "Handoffs:  Intra-node: %lld  Inter-node: %lld\n",
+				intra, inter);
 	if (fail)
 		atomic_inc(&cxt.n_lock_torture_errors);
 }
@@ -1243,6 +1256,8 @@ static int __init lock_torture_init(void)
 		for (i = 0; i < cxt.nrealwriters_stress; i++) {
 			cxt.lwsa[i].n_lock_fail = 0;
 			cxt.lwsa[i].n_lock_acquired = 0;
+			cxt.lwsa[i].n_lock_intra_node = 0;
+			cxt.lwsa[i].n_lock_inter_node = 0;
 		}
 	}
 
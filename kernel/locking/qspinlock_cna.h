@@ -0,0 +1,265 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _GEN_CNA_LOCK_SLOWPATH
+#error "do not include this file"
+#endif
+
+#include <linux/topology.h>
+
+/*
+ * Implement a NUMA-aware version of MCS (aka CNA, or compact NUMA-aware lock).
+ *
+ * In CNA, spinning threads are organized in two queues, a primary queue for
+ * threads running on the same NUMA node as the current lock holder, and a
+ * secondary queue for threads running on other nodes. Schematically, it
+ * looks like this:
+ *
+ *    cna_node
+ *   +----------+     +--------+         +--------+
+ *   |mcs:next  | --> |mcs:next| --> ... |mcs:next| --> NULL  [Primary queue]
+ *   |sec_tail  | -+  +--------+         +--------+
+ *   +----------+  |
+ *                 +----------------------+
+ *                                        v
+ *                 +--------+         +--------+
+ *                 |mcs:next| --> ... |mcs:next|            [Secondary queue]
+ *                 +--------+         +--------+
+ *                     ^                    |
+ *                     +--------------------+
+ *
+ * The secondary queue is carried in the queue node of the holder of the MCS
+ * lock: its tail is written into the node of the successor before the
+ * locked field of the latter is set, and only the MCS lock holder ever looks
+ * at it. The secondary queue is circular, so that a single pointer gives
+ * both its head and its tail.
+ *
+ * While waiting for the lock owner to go away, the queue head moves waiters
+ * of other nodes that are ahead of the first waiter of its own node to the
+ * tail of the secondary queue, so that the handoff itself stays short. The
+ * secondary queue is spliced back in front of the primary queue when no
+ * local waiter is left, or after numa_spinlock_threshold consecutive local
+ * handoffs so that remote waiters are not starved.
+ *
+ * The tail of the primary queue is never moved to the secondary queue, so
+ * that the lock word always points at a node of the primary queue. When the
+ * MCS lock holder is alone in the primary queue, the secondary queue becomes
+ * the primary queue.
+ *
+ * For more details, see https://arxiv.org/abs/1810.05600.
+ */
+
+struct cna_node {
+	struct mcs_spinlock	mcs;
+	struct cna_node		*sec_tail;	/* secondary queue, MCS lock holder */
+	u32			encoded_tail;	/* self */
+	u16			numa_node;
+	u16			intra_count;	/* local handoffs with a secondary queue */
+};
+
+/*
+ * Number of consecutive local handoffs while remote waiters wait in the
+ * secondary queue, before they are given the lock.
+ */
+static u16 numa_spinlock_threshold __read_mostly = U16_MAX;
+
+static void __init cna_init_nodes_per_cpu(unsigned int cpu)
+{
+	struct mcs_spinlock *base = per_cpu_ptr(&qnodes[0].mcs, cpu);
+	int numa_node = cpu_to_node(cpu);
+	int i;
+
+	for (i = 0; i < MAX_NODES; i++) {
+		struct cna_node *cn = (struct cna_node *)grab_mcs_node(base, i);
+
+		cn->numa_node = numa_node;
+		cn->encoded_tail = encode_tail(cpu, i);
+	}
+}
+
+static __always_inline void cna_init_node(struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	BUILD_BUG_ON(sizeof(struct cna_node) > sizeof(struct qnode));
+
+	cn->sec_tail = NULL;
+	cn->intra_count = 0;
+}
+
+/*
+ * cna_order_queue - move the waiters of other nodes ahead of the first waiter
+ * of our node to the tail of the secondary queue
+ *
+ * Called by the MCS lock holder, on the nodes linked behind it so far. The
+ * ->next pointers being changed are all non-NULL, so that no waiter queueing
+ * concurrently can write them.
+ */
+static void cna_order_queue(struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	struct mcs_spinlock *next = READ_ONCE(node->next);
+	struct mcs_spinlock *last = node, *iter = next;
+	int nr = 0;
+
+	while (iter && ((struct cna_node *)iter)->numa_node != cn->numa_node) {
+		last = iter;
+		iter = READ_ONCE(iter->next);
+		nr++;
+	}
+
+	/* No local waiter, or it is already next in line */
+	if (!iter || last == node)
+		return;
+
+	if (cn->sec_tail) {
+		last->next = cn->sec_tail->mcs.next;
+		cn->sec_tail->mcs.next = next;
+	} else {
+		last->next = next;
+	}
+	cn->sec_tail = (struct cna_node *)last;
+	WRITE_ONCE(node->next, iter);
+
+	lockevent_add(cna_reorder, nr);
+}
+
+static __always_inline u32 cna_wait_head_or_lock(struct qspinlock *lock,
+						 struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	if (cn->intra_count < numa_spinlock_threshold)
+		cna_order_queue(node);
+
+	return 0; /* we lied; we didn't wait, go do so now */
+}
+
+/*
+ * If the MCS lock holder is alone in the primary queue but has a secondary
+ * queue, make the latter the primary queue instead of clearing the tail.
+ */
+static __always_inline bool cna_try_clear_tail(struct qspinlock *lock, u32 val,
+					       struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	struct cna_node *tail = cn->sec_tail;
+	struct mcs_spinlock *head;
+
+	if (!tail)
+		return __try_clear_tail(lock, val, node);
+
+	/*
+	 * Terminate the secondary queue before it becomes visible through the
+	 * lock word; the release orders this against the store of the next
+	 * waiter queueing behind @tail.
+	 */
+	head = tail->mcs.next;
+	tail->mcs.next = NULL;
+	if (!atomic_try_cmpxchg_release(&lock->val, &val,
+					tail->encoded_tail | _Q_LOCKED_VAL)) {
+		tail->mcs.next = head;
+		return false;
+	}
+
+	lockevent_cond_inc(cna_intra_node,
+			   ((struct cna_node *)head)->numa_node == cn->numa_node);
+	lockevent_cond_inc(cna_inter_node,
+			   ((struct cna_node *)head)->numa_node != cn->numa_node);
+	arch_mcs_spin_unlock_contended(&head->locked);
+	return true;
+}
+
+static __always_inline void cna_lock_handoff(struct mcs_spinlock *node,
+					     struct mcs_spinlock *next)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	struct cna_node *tail = cn->sec_tail;
+	struct cna_node *cnext;
+	u16 intra_count = 0;
+
+	/* cna_order_queue() may have moved our successor */
+	next = READ_ONCE(node->next);
+	cnext = (struct cna_node *)next;
+
+	if (tail) {
+		if (cnext->numa_node == cn->numa_node &&
+		    cn->intra_count < numa_spinlock_threshold) {
+			/* Pass the secondary queue on */
+			cnext->sec_tail = tail;
+			intra_count = cn->intra_count + 1;
+		} else {
+			/* Splice the secondary queue in front of @next */
+			lockevent_cond_inc(cna_flush,
+					   cnext->numa_node == cn->numa_node);
+			next = tail->mcs.next;
+			tail->mcs.next = &cnext->mcs;
+			cnext = (struct cna_node *)next;
+		}
+	}
+	cnext->intra_count = intra_count;
+
+	lockevent_cond_inc(cna_intra_node, cnext->numa_node == cn->numa_node);
+	lockevent_cond_inc(cna_inter_node, cnext->numa_node != cn->numa_node);
+
+	arch_mcs_spin_unlock_contended(&next->locked);
+}
+
+/*
+ * Constant (boot-param configurable) flag selecting the NUMA-aware variant
+ * of spinlock.  Possible values: -1 (off) / 0 (auto, default) / 1 (on).
+ */
+static int numa_spinlock_flag;
+
+static int __init numa_spinlock_setup(char *str)
+{
+	if (!strcmp(str, "auto")) {
+		numa_spinlock_flag = 0;
+		return 1;
+	} else if (!strcmp(str, "on")) {
+		numa_spinlock_flag = 1;
+		return 1;
+	} else if (!strcmp(str, "off")) {
+		numa_spinlock_flag = -1;
+		return 1;
+	}
+
+	return 0;
+}
+__setup("numa_spinlock=", numa_spinlock_setup);
+
+static int __init numa_spinlock_threshold_setup(char *str)
+{
+	u16 threshold;
+
+	if (kstrtou16(str, 0, &threshold))
+		return 0;
+
+	numa_spinlock_threshold = threshold;
+	return 1;
+}
+__setup("numa_spinlock_threshold=", numa_spinlock_threshold_setup);
+
+/*
+ * Switch to the NUMA-aware slow path before the secondary CPUs are brought
+ * up: a CNA lock holder must never hand the lock to a waiter queued by the
+ * native slow path, which does not initialize the CNA fields of its node.
+ */
+static int __init cna_configure_spin_lock_slowpath(void)
+{
+	unsigned int cpu;
+
+	if (numa_spinlock_flag < 0 ||
+	    (!numa_spinlock_flag && num_possible_nodes() == 1))
+		return 0;
+
+	if (WARN_ON_ONCE(num_online_cpus() > 1))
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		cna_init_nodes_per_cpu(cpu);
+
+	static_branch_enable(&cna_spinlock_key);
+
+	pr_info("Enabling CNA spinlock\n");
+	return 0;
+}
+early_initcall(cna_configure_spin_lock_slowpath);
@@ -27,6 +27,8 @@
 #include <linux/export.h>
 #include <linux/rwsem.h>
 #include <linux/atomic.h>
+#include <linux/hash.h>
+#include <linux/slab.h>
 #include <trace/events/lock.h>
 
 #ifndef CONFIG_PREEMPT_RT
@@ -324,6 +326,10 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	raw_spin_lock_init(&sem->wait_lock);
 	INIT_LIST_HEAD(&sem->wait_list);
 	atomic_long_set(&sem->owner, 0L);
+#ifdef CONFIG_RWSEM_READER_BIAS
+	sem->rbias = 0;
+	sem->rbias_inhibit_until = 0;
+#endif
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	osq_lock_init(&sem->osq);
 #endif
@@ -1237,10 +1243,260 @@ static struct rw_semaphore *rwsem_downgrade_wake(struct rw_semaphore *sem)
 	return sem;
 }
 
+#ifdef CONFIG_RWSEM_READER_BIAS
+/*
+ * Reader bias (BRAVO, https://arxiv.org/abs/1810.01553)
+ *
+ * Readers of an rwsem with the bias on take it by installing the rwsem in
+ * their slot of a global table of visible readers instead of adding
+ * RWSEM_READER_BIAS to the shared count. A reader that finds its slot
+ * taken, or the bias off, uses count as usual. The rwsem picks a set of
+ * slots, and the task one slot, or way, in the set. The slots of a set
+ * are in different cachelines, so readers don't share lines, and writers
+ * and rwsem_is_locked() only look at the set. The table is sized at boot
+ * for twice as many ways as there are possible CPUs, so that the readers
+ * running at any time mostly get a slot of their own.
+ *
+ * Writers take the rwsem through count, which biased readers leave alone,
+ * then revoke the bias: turn it off and wait for the slots holding the
+ * rwsem to be released. A writer which stops waiting, on a trylock or a
+ * fatal signal, leaves the bias being revoked: readers don't use it, but
+ * the next writer still looks for the remaining biased readers. The cost
+ * of the revocation inhibits the bias for RWSEM_RBIAS_INHIBIT_MULT times
+ * as long, so that rwsems with frequent writers fall back to the normal
+ * path. The bias is turned back on by a reader taking the rwsem through
+ * count while other readers hold it.
+ *
+ * up_read() releases the slot of (rwsem, current) if it holds the rwsem,
+ * and count otherwise. All the read holds of an rwsem being equivalent, it
+ * does not matter which one is released when a task holds it several times
+ * or when another task's slot collides. up_read_non_owner(), which may run
+ * in another task than the one which took the hold, releases any slot of
+ * the set holding the rwsem instead.
+ */
+#define RWSEM_RBIAS_SET_BITS		8
+#define RWSEM_RBIAS_MIN_WAYS		16
+#define RWSEM_RBIAS_MAX_WAYS		8192
+#define RWSEM_RBIAS_INHIBIT_MULT	9
+#define RWSEM_RBIAS_SPINS		1024
+
+/* sem->rbias */
+#define RWSEM_RBIAS_OFF			0
+#define RWSEM_RBIAS_ON			1
+#define RWSEM_RBIAS_REVOKING		2
+
+static struct rw_semaphore **rwsem_visible_readers __ro_after_init;
+static unsigned int rwsem_rbias_way_bits __ro_after_init;
+
+static int __init rwsem_rbias_init(void)
+{
+	unsigned int ways = clamp_t(unsigned int,
+				    roundup_pow_of_two(2 * nr_cpu_ids),
+				    RWSEM_RBIAS_MIN_WAYS, RWSEM_RBIAS_MAX_WAYS);
+
+	rwsem_rbias_way_bits = ilog2(ways);
+	rwsem_visible_readers = kvcalloc(ways << RWSEM_RBIAS_SET_BITS,
+					 sizeof(*rwsem_visible_readers),
+					 GFP_KERNEL);
+	if (!rwsem_visible_readers)
+		return -ENOMEM;
+
+	return 0;
+}
+early_initcall(rwsem_rbias_init);
+
+static inline unsigned int rwsem_rbias_ways(void)
+{
+	return 1U << rwsem_rbias_way_bits;
+}
+
+/* The way-th slot of the set of @sem */
+static inline struct rw_semaphore **
+rwsem_rbias_way(struct rw_semaphore *sem, unsigned int way)
+{
+	unsigned int set = hash_ptr(sem, RWSEM_RBIAS_SET_BITS);
+
+	return &rwsem_visible_readers[(way << RWSEM_RBIAS_SET_BITS) | set];
+}
+
+static inline struct rw_semaphore **rwsem_rbias_slot(struct rw_semaphore *sem)
+{
+	return rwsem_rbias_way(sem, hash_ptr(current, rwsem_rbias_way_bits));
+}
+
+static inline bool rwsem_rbias_read_trylock(struct rw_semaphore *sem)
+{
+	struct rw_semaphore **slot;
+
+	if (READ_ONCE(sem->rbias) != RWSEM_RBIAS_ON)
+		return false;
+
+	slot = rwsem_rbias_slot(sem);
+	if (READ_ONCE(*slot) || cmpxchg(slot, NULL, sem))
+		return false;
+
+	/*
+	 * Pairs with the smp_mb() in rwsem_rbias_revoke(): either the writer
+	 * sees our slot, or we see the bias off. The acquire pairs with the
+	 * release of the reader which enabled the bias while holding count.
+	 */
+	if (likely(smp_load_acquire(&sem->rbias) == RWSEM_RBIAS_ON)) {
+		lockevent_inc(rwsem_rlock_bias);
+		return true;
+	}
+
+	WRITE_ONCE(*slot, NULL);
+	return false;
+}
+
+static inline bool rwsem_rbias_up_read(struct rw_semaphore *sem)
+{
+	struct rw_semaphore **slot = rwsem_rbias_slot(sem);
+
+	if (READ_ONCE(*slot) != sem)
+		return false;
+
+	return cmpxchg_release(slot, sem, NULL) == sem;
+}
+
+/* Release a biased hold of @sem whichever task took it */
+static inline bool rwsem_rbias_up_read_any(struct rw_semaphore *sem)
+{
+	unsigned int way;
+
+	/* The bias is only off once no biased reader is left */
+	if (READ_ONCE(sem->rbias) == RWSEM_RBIAS_OFF)
+		return false;
+
+	for (way = 0; way < rwsem_rbias_ways(); way++) {
+		struct rw_semaphore **slot = rwsem_rbias_way(sem, way);
+
+		if (READ_ONCE(*slot) == sem &&
+		    cmpxchg_release(slot, sem, NULL) == sem)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Called with a read lock taken through count, while @count readers (us
+ * included) hold it.
+ */
+static inline void rwsem_rbias_enable(struct rw_semaphore *sem, long count)
+{
+	if (READ_ONCE(sem->rbias) != RWSEM_RBIAS_OFF ||
+	    (count >> RWSEM_READER_SHIFT) < 2)
+		return;
+
+	/* Not before the table is there */
+	if (unlikely(!rwsem_visible_readers))
+		return;
+
+	if (sched_clock() < READ_ONCE(sem->rbias_inhibit_until))
+		return;
+
+	smp_store_release(&sem->rbias, RWSEM_RBIAS_ON);
+}
+
+/*
+ * Revoke the reader bias of a write-locked rwsem and wait for the biased
+ * readers to leave, sleeping in @state once spinning took long enough.
+ * With TASK_RUNNING, don't wait: return -EBUSY if biased readers are
+ * left. Return -EINTR if a signal @state allows is pending while waiting.
+ * On error, the bias is left being revoked.
+ */
+static int rwsem_rbias_revoke(struct rw_semaphore *sem, unsigned int state)
+{
+	unsigned int way, spins;
+	int ret = 0;
+	u64 start;
+
+	if (READ_ONCE(sem->rbias) == RWSEM_RBIAS_OFF)
+		return 0;
+
+	start = sched_clock();
+	WRITE_ONCE(sem->rbias, RWSEM_RBIAS_REVOKING);
+	/* Pairs with the cmpxchg() in rwsem_rbias_read_trylock() */
+	smp_mb();
+
+	for (way = 0; way < rwsem_rbias_ways(); way++) {
+		struct rw_semaphore **slot = rwsem_rbias_way(sem, way);
+
+		for (spins = 0; READ_ONCE(*slot) == sem; spins++) {
+			if (state == TASK_RUNNING) {
+				ret = -EBUSY;
+				goto out;
+			}
+			/* Biased readers may sleep while holding the rwsem */
+			if (spins < RWSEM_RBIAS_SPINS) {
+				cpu_relax();
+				continue;
+			}
+			if (signal_pending_state(state, current)) {
+				ret = -EINTR;
+				goto out;
+			}
+			set_current_state(state);
+			schedule_timeout(1);
+		}
+	}
+	/* Order the critical section after the release of the last reader */
+	smp_acquire__after_ctrl_dep();
+	WRITE_ONCE(sem->rbias, RWSEM_RBIAS_OFF);
+
+out:
+	WRITE_ONCE(sem->rbias_inhibit_until, sched_clock() +
+		   (sched_clock() - start) * RWSEM_RBIAS_INHIBIT_MULT);
+	lockevent_inc(rwsem_rbias_revoke);
+	return ret;
+}
+
+bool rwsem_rbias_is_locked(struct rw_semaphore *sem)
+{
+	unsigned int way;
+
+	/* The bias is only off once no biased reader is left */
+	if (READ_ONCE(sem->rbias) == RWSEM_RBIAS_OFF)
+		return false;
+
+	for (way = 0; way < rwsem_rbias_ways(); way++) {
+		if (READ_ONCE(*rwsem_rbias_way(sem, way)) == sem)
+			return true;
+	}
+
+	return false;
+}
+EXPORT_SYMBOL(rwsem_rbias_is_locked);
+#else
+static inline bool rwsem_rbias_read_trylock(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline bool rwsem_rbias_up_read(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline bool rwsem_rbias_up_read_any(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline void rwsem_rbias_enable(struct rw_semaphore *sem, long count) { }
+
+static inline int rwsem_rbias_revoke(struct rw_semaphore *sem,
+				     unsigned int state)
+{
+	return 0;
+}
+#endif /* CONFIG_RWSEM_READER_BIAS */
+
 /*
  * lock for reading
  */
-static __always_inline int __down_read_common(struct rw_semaphore *sem, int state)
+static __always_inline int __down_read_count(struct rw_semaphore *sem, int state)
 {
 	int ret = 0;
 	long count;
@@ -1252,12 +1508,22 @@ static __always_inline int __down_read_common(struct rw_semaphore *sem, int stat
 			goto out;
 		}
 		DEBUG_RWSEMS_WARN_ON(!is_rwsem_reader_owned(sem), sem);
+	} else {
+		rwsem_rbias_enable(sem, count);
 	}
 out:
 	preempt_enable();
 	return ret;
 }
 
+static __always_inline int __down_read_common(struct rw_semaphore *sem, int state)
+{
+	if (rwsem_rbias_read_trylock(sem))
+		return 0;
+
+	return __down_read_count(sem, state);
+}
+
 static __always_inline void __down_read(struct rw_semaphore *sem)
 {
 	__down_read_common(sem, TASK_UNINTERRUPTIBLE);
@@ -1273,6 +1539,11 @@ static __always_inline int __down_read_killable(struct rw_semaphore *sem)
 	return __down_read_common(sem, TASK_KILLABLE);
 }
 
+static __always_inline void __down_read_non_owner(struct rw_semaphore *sem)
+{
+	__down_read(sem);
+}
+
 static inline int __down_read_trylock(struct rw_semaphore *sem)
 {
 	int ret = 0;
@@ -1280,12 +1551,16 @@ static inline int __down_read_trylock(struct rw_semaphore *sem)
 
 	DEBUG_RWSEMS_WARN_ON(sem->magic != sem, sem);
 
+	if (rwsem_rbias_read_trylock(sem))
+		return 1;
+
 	preempt_disable();
 	tmp = atomic_long_read(&sem->count);
 	while (!(tmp & RWSEM_READ_FAILED_MASK)) {
 		if (atomic_long_try_cmpxchg_acquire(&sem->count, &tmp,
 						    tmp + RWSEM_READER_BIAS)) {
 			rwsem_set_reader_owned(sem);
+			rwsem_rbias_enable(sem, tmp + RWSEM_READER_BIAS);
 			ret = 1;
 			break;
 		}
@@ -1294,6 +1569,8 @@ static inline int __down_read_trylock(struct rw_semaphore *sem)
 	return ret;
 }
 
+static inline void __up_write(struct rw_semaphore *sem);
+
 /*
  * lock for writing
  */
@@ -1307,6 +1584,11 @@ static inline int __down_write_common(struct rw_semaphore *sem, int state)
 			ret = -EINTR;
 	}
 	preempt_enable();
+
+	if (!ret && rwsem_rbias_revoke(sem, state)) {
+		__up_write(sem);
+		ret = -EINTR;
+	}
 	return ret;
 }
 
@@ -1329,13 +1611,18 @@ static inline int __down_write_trylock(struct rw_semaphore *sem)
 	ret = rwsem_write_trylock(sem);
 	preempt_enable();
 
+	if (ret && rwsem_rbias_revoke(sem, TASK_RUNNING)) {
+		__up_write(sem);
+		ret = 0;
+	}
+
 	return ret;
 }
 
 /*
  * unlock after reading
  */
-static inline void __up_read(struct rw_semaphore *sem)
+static inline void __up_read_count(struct rw_semaphore *sem)
 {
 	long tmp;
 
@@ -1354,6 +1641,18 @@ static inline void __up_read(struct rw_semaphore *sem)
 	preempt_enable();
 }
 
+static inline void __up_read(struct rw_semaphore *sem)
+{
+	if (!rwsem_rbias_up_read(sem))
+		__up_read_count(sem);
+}
+
+static inline void __up_read_non_owner(struct rw_semaphore *sem)
+{
+	if (!rwsem_rbias_up_read_any(sem))
+		__up_read_count(sem);
+}
+
 /*
  * unlock after writing
  */
@@ -1465,6 +1764,11 @@ static inline int __down_read_killable(struct rw_semaphore *sem)
 	return rwbase_read_lock(&sem->rwbase, TASK_KILLABLE);
 }
 
+static inline void __down_read_non_owner(struct rw_semaphore *sem)
+{
+	__down_read(sem);
+}
+
 static inline int __down_read_trylock(struct rw_semaphore *sem)
 {
 	return rwbase_read_trylock(&sem->rwbase);
@@ -1475,6 +1779,11 @@ static inline void __up_read(struct rw_semaphore *sem)
 	rwbase_read_unlock(&sem->rwbase, TASK_NORMAL);
 }
 
+static inline void __up_read_non_owner(struct rw_semaphore *sem)
+{
+	__up_read(sem);
+}
+
 static inline void __sched __down_write(struct rw_semaphore *sem)
 {
 	rwbase_write_lock(&sem->rwbase, TASK_UNINTERRUPTIBLE);
@@ -1675,20 +1984,6 @@ void _down_write_nest_lock(struct rw_semaphore *sem, struct lockdep_map *nest)
 }
 EXPORT_SYMBOL(_down_write_nest_lock);
 
-void down_read_non_owner(struct rw_semaphore *sem)
-{
-	might_sleep();
-	__down_read(sem);
-	/*
-	 * The owner value for a reader-owned lock is mostly for debugging
-	 * purpose only and is not critical to the correct functioning of
-	 * rwsem. So it is perfectly fine to set it in a preempt-enabled
-	 * context here.
-	 */
-	__rwsem_set_reader_owned(sem, NULL);
-}
-EXPORT_SYMBOL(down_read_non_owner);
-
 void down_write_nested(struct rw_semaphore *sem, int subclass)
 {
 	might_sleep();
@@ -1712,10 +2007,27 @@ int __sched down_write_killable_nested(struct rw_semaphore *sem, int subclass)
 }
 EXPORT_SYMBOL(down_write_killable_nested);
 
+#endif
+
+#if defined(CONFIG_DEBUG_LOCK_ALLOC) || defined(CONFIG_RWSEM_READER_BIAS)
+
+void down_read_non_owner(struct rw_semaphore *sem)
+{
+	might_sleep();
+	__down_read_non_owner(sem);
+	/*
+	 * The owner value for a reader-owned lock is mostly for debugging
+	 * purpose only and is not critical to the correct functioning of
+	 * rwsem. So it is perfectly fine to set it in a preempt-enabled
+	 * context here.
+	 */
+	__rwsem_set_reader_owned(sem, NULL);
+}
+EXPORT_SYMBOL(down_read_non_owner);
+
 void up_read_non_owner(struct rw_semaphore *sem)
 {
-	DEBUG_RWSEMS_WARN_ON(!is_rwsem_reader_owned(sem), sem);
-	__up_read(sem);
+	__up_read_non_owner(sem);
 }
 EXPORT_SYMBOL(up_read_non_owner);
 
@@ -39,6 +39,7 @@
 #include <linux/torture.h>
 #include <linux/vmalloc.h>
 #include <linux/rcupdate_trace.h>
+#include <linux/prefetch.h>
 
 #include "rcu.h"
 
@@ -98,6 +99,7 @@ torture_param(int, writer_holdoff_jiffies, 0, "Holdoff (jiffies) between GPs, ze
 torture_param(int, kfree_rcu_test, 0, "Do we run a kfree_rcu() scale test?");
 torture_param(int, kfree_mult, 1, "Multiple of kfree_obj size to allocate.");
 torture_param(int, kfree_by_call_rcu, 0, "Use call_rcu() to emulate kfree_rcu()?");
+torture_param(int, kfree_by_call_rcu_batch, 0, "Use call_rcu_batch() to emulate kfree_rcu()?");
 
 static char *scale_type = "rcu";
 module_param(scale_type, charp, 0444);
@@ -606,6 +608,9 @@ static atomic_t n_kfree_scale_thread_started;
 static atomic_t n_kfree_scale_thread_ended;
 static struct task_struct *kthread_tp;
 static u64 kthread_stime;
+static atomic_long_t n_kfree_scale_cbs;
+static u64 kfree_scale_first_start;
+static struct rcu_batch kfree_scale_batch;
 
 struct kfree_obj {
 	char kfree_obj[8];
@@ -620,11 +625,24 @@ static void kfree_call_rcu(struct rcu_head *rh)
 	kfree(obj);
 }
 
+/* Used if doing RCU-kfree'ing via call_rcu_batch(). */
+static void kfree_call_rcu_batch(struct rcu_head *list)
+{
+	struct rcu_head *rh, *next;
+
+	for (rh = list; rh; rh = next) {
+		next = rh->next;
+		prefetch(next);
+		kfree(container_of(rh, struct kfree_obj, rh));
+	}
+}
+
 static int
 kfree_scale_thread(void *arg)
 {
-	int i, loop = 0;
+	int i, loop = 0, started;
 	long me = (long)arg;
+	long ncbs = 0;
 	struct kfree_obj *alloc_ptr;
 	u64 start_time, end_time;
 	long long mem_begin, mem_during = 0;
@@ -638,7 +656,10 @@ kfree_scale_thread(void *arg)
 
 	start_time = ktime_get_mono_fast_ns();
 
-	if (atomic_inc_return(&n_kfree_scale_thread_started) >= kfree_nrealthreads) {
+	started = atomic_inc_return(&n_kfree_scale_thread_started);
+	if (started == 1)
+		WRITE_ONCE(kfree_scale_first_start, start_time);
+	if (started >= kfree_nrealthreads) {
 		if (gp_exp)
 			b_rcu_gp_test_started = cur_ops->exp_completed() / 2;
 		else
@@ -659,6 +680,13 @@ kfree_scale_thread(void *arg)
 
 			if (kfree_by_call_rcu) {
 				call_rcu(&(alloc_ptr->rh), kfree_call_rcu);
+				ncbs++;
+				continue;
+			}
+
+			if (kfree_by_call_rcu_batch) {
+				call_rcu_batch(&kfree_scale_batch, &alloc_ptr->rh);
+				ncbs++;
 				continue;
 			}
 
@@ -676,6 +704,10 @@ kfree_scale_thread(void *arg)
 		cond_resched();
 	} while (!torture_must_stop() && ++loop < kfree_loops);
 
+	// Count the callbacks once per thread, not in the callbacks, which
+	// would add a shared atomic to the path being measured.
+	atomic_long_add(ncbs, &n_kfree_scale_cbs);
+
 	if (atomic_inc_return(&n_kfree_scale_thread_ended) >= kfree_nrealthreads) {
 		end_time = ktime_get_mono_fast_ns();
 
@@ -689,6 +721,25 @@ kfree_scale_thread(void *arg)
 		       rcuscale_seq_diff(b_rcu_gp_test_finished, b_rcu_gp_test_started),
 		       (mem_begin - mem_during) >> (20 - PAGE_SHIFT));
 
+		// Callback throughput, from the start of the first kfree'er
+		// to the last callback invocation. All the callbacks queued
+		// have been invoked once the barrier returns.
+		if (kfree_by_call_rcu || kfree_by_call_rcu_batch) {
+			u64 first_start = READ_ONCE(kfree_scale_first_start);
+
+			if (kfree_by_call_rcu)
+				rcu_barrier();
+			else
+				rcu_batch_barrier(&kfree_scale_batch);
+			end_time = ktime_get_mono_fast_ns();
+			ncbs = atomic_long_read(&n_kfree_scale_cbs);
+			pr_alert("Callbacks invoked: %ld in %llu ns, %llu callbacks/s (%s)\n",
+				 ncbs, (unsigned long long)(end_time - first_start),
+				 div64_u64((u64)ncbs * NSEC_PER_SEC,
+					   max_t(u64, end_time - first_start, 1)),
+				 kfree_by_call_rcu ? "call_rcu" : "call_rcu_batch");
+		}
+
 		if (shutdown) {
 			smp_mb(); /* Assign before wake. */
 			wake_up(&shutdown_wq);
@@ -714,6 +765,7 @@ kfree_scale_cleanup(void)
 		kfree(kfree_reader_tasks);
 	}
 
+	rcu_batch_destroy(&kfree_scale_batch);
 	torture_cleanup_end();
 }
 
@@ -752,8 +804,14 @@ kfree_scale_init(void)
 	unsigned long orig_jif;
 
 	pr_alert("%s" SCALE_FLAG
-		 "--- kfree_rcu_test: kfree_mult=%d kfree_by_call_rcu=%d kfree_nthreads=%d kfree_alloc_num=%d kfree_loops=%d kfree_rcu_test_double=%d kfree_rcu_test_single=%d\n",
-		 scale_type, kfree_mult, kfree_by_call_rcu, kfree_nthreads, kfree_alloc_num, kfree_loops, kfree_rcu_test_double, kfree_rcu_test_single);
+		 "--- kfree_rcu_test: kfree_mult=%d kfree_by_call_rcu=%d kfree_by_call_rcu_batch=%d kfree_nthreads=%d kfree_alloc_num=%d kfree_loops=%d kfree_rcu_test_double=%d kfree_rcu_test_single=%d\n",
+		 scale_type, kfree_mult, kfree_by_call_rcu, kfree_by_call_rcu_batch, kfree_nthreads, kfree_alloc_num, kfree_loops, kfree_rcu_test_double, kfree_rcu_test_single);
+
+	if (kfree_by_call_rcu_batch) {
+		firsterr = rcu_batch_init(&kfree_scale_batch, kfree_call_rcu_batch);
+		if (firsterr)
+			goto unwind;
+	}
 
 	// Also, do a quick self-test to ensure laziness is as much as
 	// expected.
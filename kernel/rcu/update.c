@@ -44,6 +44,7 @@
 #include <linux/slab.h>
 #include <linux/irq_work.h>
 #include <linux/rcupdate_trace.h>
+#include <linux/workqueue.h>
 
 #define CREATE_TRACE_POINTS
 
@@ -653,6 +654,178 @@ late_initcall(rcu_verify_early_boot_tests);
 void rcu_early_boot_tests(void) {}
 #endif /* CONFIG_PROVE_RCU */
 
+/*
+ * Batched RCU callbacks.
+ *
+ * Each CPU keeps, for each rcu_batch, a list of the objects queued on it
+ * since its last batch was handed to RCU, and at most one batch waiting
+ * for a grace period through an rcu_work. When that batch is ready, the
+ * workqueue handler passes it to the rcu_batch handler in a single call,
+ * then hands the objects queued meanwhile to RCU as the next batch. This
+ * costs one RCU callback per batch instead of one per object, and lets the
+ * handler free the objects in bulk, from process context.
+ */
+struct rcu_batch_cpu {
+	raw_spinlock_t lock;
+	struct rcu_head *head;		/* Objects not yet waiting for a GP. */
+	struct rcu_head *head_free;	/* Objects waiting for the GP of @rwork. */
+	struct rcu_work rwork;
+	struct rcu_batch *rb;
+};
+
+/* Queue the pending objects of @rbc as its next batch, if it has none. */
+static void rcu_batch_queue(struct rcu_batch_cpu *rbc)
+{
+	lockdep_assert_held(&rbc->lock);
+
+	if (rbc->head_free || !rbc->head)
+		return;
+
+	rbc->head_free = rbc->head;
+	rbc->head = NULL;
+	queue_rcu_work(system_wq, &rbc->rwork);
+}
+
+static void rcu_batch_workfn(struct work_struct *work)
+{
+	struct rcu_batch_cpu *rbc = container_of(to_rcu_work(work),
+						 struct rcu_batch_cpu, rwork);
+	struct rcu_head *list;
+	unsigned long flags;
+
+	/* Nothing else touches ->head_free until it is cleared below. */
+	list = READ_ONCE(rbc->head_free);
+
+#ifdef CONFIG_DEBUG_OBJECTS_RCU_HEAD
+	{
+		struct rcu_head *rhp;
+
+		for (rhp = list; rhp; rhp = rhp->next)
+			debug_rcu_head_unqueue(rhp);
+	}
+#endif
+
+	rcu_lock_acquire(&rcu_callback_map);
+	rbc->rb->func(list);
+	rcu_lock_release(&rcu_callback_map);
+
+	/* The batch is no longer in flight once the handler returned. */
+	raw_spin_lock_irqsave(&rbc->lock, flags);
+	rbc->head_free = NULL;
+	rcu_batch_queue(rbc);
+	raw_spin_unlock_irqrestore(&rbc->lock, flags);
+}
+
+/**
+ * rcu_batch_init() - Initialize a batch of RCU callbacks
+ * @rb: the rcu_batch to initialize
+ * @func: handler invoked with lists of objects whose grace period elapsed
+ *
+ * @func is invoked from process context, with lists of up to all the
+ * objects queued on a CPU during a grace period; it may sleep, and should
+ * call cond_resched() if it processes long lists.
+ *
+ * Return: 0 on success, -ENOMEM otherwise.
+ */
+int rcu_batch_init(struct rcu_batch *rb, rcu_batch_func_t func)
+{
+	int cpu;
+
+	rb->func = func;
+	rb->pcpu = alloc_percpu(struct rcu_batch_cpu);
+	if (!rb->pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_batch_cpu *rbc = per_cpu_ptr(rb->pcpu, cpu);
+
+		raw_spin_lock_init(&rbc->lock);
+		INIT_RCU_WORK(&rbc->rwork, rcu_batch_workfn);
+		rbc->rb = rb;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rcu_batch_init);
+
+/**
+ * call_rcu_batch() - Queue an object for a batched RCU callback
+ * @rb: the rcu_batch whose handler frees the object
+ * @head: rcu_head of the object
+ *
+ * The handler of @rb will be passed @head, among other objects, after a
+ * full grace period has elapsed, with the same memory-ordering guarantees
+ * as call_rcu(). It may be called from any context call_rcu() can.
+ */
+void call_rcu_batch(struct rcu_batch *rb, struct rcu_head *head)
+{
+	struct rcu_batch_cpu *rbc;
+	unsigned long flags;
+
+	if (debug_rcu_head_queue(head)) {
+		/* Probable double call_rcu_batch(), just leak. */
+		WARN_ONCE(1, "%s(): Double-freed call. rcu_head %p\n",
+			  __func__, head);
+		return;
+	}
+
+	local_irq_save(flags);
+	rbc = this_cpu_ptr(rb->pcpu);
+	raw_spin_lock(&rbc->lock);
+	head->next = rbc->head;
+	rbc->head = head;
+	rcu_batch_queue(rbc);
+	raw_spin_unlock_irqrestore(&rbc->lock, flags);
+}
+EXPORT_SYMBOL_GPL(call_rcu_batch);
+
+/**
+ * rcu_batch_barrier() - Wait for the objects queued on an rcu_batch
+ * @rb: the rcu_batch to wait for
+ *
+ * Wait until the handler of @rb has been invoked on all the objects queued
+ * before the call. Like rcu_barrier(), this does not wait for objects
+ * queued concurrently, and can take a long time if new ones keep coming.
+ */
+void rcu_batch_barrier(struct rcu_batch *rb)
+{
+	int cpu;
+
+	might_sleep();
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_batch_cpu *rbc = per_cpu_ptr(rb->pcpu, cpu);
+
+		/*
+		 * A pending list implies a batch in flight, see
+		 * rcu_batch_queue(). Flush at least once to also wait for
+		 * rcu_batch_workfn() to be done with @rbc.
+		 */
+		do {
+			flush_rcu_work(&rbc->rwork);
+		} while (data_race(READ_ONCE(rbc->head_free)));
+	}
+}
+EXPORT_SYMBOL_GPL(rcu_batch_barrier);
+
+/**
+ * rcu_batch_destroy() - Release an rcu_batch
+ * @rb: the rcu_batch to release
+ *
+ * Wait for the objects queued on @rb to be handled, then release it. No
+ * object must be queued on @rb concurrently or afterwards.
+ */
+void rcu_batch_destroy(struct rcu_batch *rb)
+{
+	if (!rb->pcpu)
+		return;
+
+	rcu_batch_barrier(rb);
+	free_percpu(rb->pcpu);
+	rb->pcpu = NULL;
+}
+EXPORT_SYMBOL_GPL(rcu_batch_destroy);
+
 #include "tasks.h"
 
 #ifndef CONFIG_TINY_RCU
@@ -1013,6 +1013,10 @@ void wake_up_q(struct wake_q_head *head)
 {
 	struct wake_q_node *node = head->first;
 
+	if (node == WAKE_Q_TAIL)
+		return;
+
+	wake_up_batch_begin();
 	while (node != WAKE_Q_TAIL) {
 		struct task_struct *task;
 
@@ -1028,6 +1032,7 @@ void wake_up_q(struct wake_q_head *head)
 		wake_up_process(task);
 		put_task_struct(task);
 	}
+	wake_up_batch_end();
 }
 
 /*
@@ -3910,6 +3915,11 @@ void sched_ttwu_pending(void *arg)
 	rq_unlock_irqrestore(rq, &rf);
 }
 
+/* Nesting depth of wake_up_batch_begin() on this CPU */
+static DEFINE_PER_CPU(unsigned int, ttwu_batch_depth);
+/* Tasks woken by the batch of this CPU, not queued on their CPU yet */
+static DEFINE_PER_CPU(struct llist_head, ttwu_batch_list);
+
 /*
  * Prepare the scene for sending an IPI for a remote smp_call
  *
@@ -3939,8 +3949,65 @@ static void __ttwu_queue_wakelist(struct task_struct *p, int cpu, int wake_flags
 	p->sched_remote_wakeup = !!(wake_flags & WF_MIGRATED);
 
 	WRITE_ONCE(rq->ttwu_pending, 1);
-	__smp_call_single_queue(cpu, &p->wake_entry.llist);
+	/*
+	 * Inside a wakeup batch only stage the task on this CPU; it is queued
+	 * on its CPU, and the IPIs for all the CPUs woken by the batch sent,
+	 * in wake_up_batch_end(). Staging it rather than queueing it keeps
+	 * the call_single_queue of @cpu empty, so that the IPIs of the csds
+	 * other CPUs queue there meanwhile aren't held back by the batch.
+	 * The task is TASK_WAKING until then, which keeps task_cpu() stable.
+	 * Interrupts nesting in the batch don't know when it ends.
+	 */
+	if (__this_cpu_read(ttwu_batch_depth) && in_task())
+		__llist_add(&p->wake_entry.llist, this_cpu_ptr(&ttwu_batch_list));
+	else
+		__smp_call_single_queue(cpu, &p->wake_entry.llist);
+}
+
+/* Queue the tasks staged by the batch on their CPUs and kick those */
+static void ttwu_batch_flush(void)
+{
+	struct llist_node *llist = __llist_del_all(this_cpu_ptr(&ttwu_batch_list));
+	struct task_struct *p, *t;
+
+	if (!llist)
+		return;
+
+	llist = llist_reverse_order(llist);
+	llist_for_each_entry_safe(p, t, llist, wake_entry.llist)
+		__smp_call_single_queue_deferred(task_cpu(p), &p->wake_entry.llist);
+
+	smp_send_deferred_call_ipis();
+}
+
+/**
+ * wake_up_batch_begin - start batching remote wakeups
+ *
+ * Remote wakeups issued by this task until the matching wake_up_batch_end()
+ * are held back, then queued on the target CPUs and their IPIs sent
+ * together, as one multicast IPI when the architecture has one, instead of
+ * one IPI per wakee. Meant for waking many tasks spread over many CPUs in
+ * a row; batches nest. Disables preemption until wake_up_batch_end(), so
+ * it must not be opened around code which sleeps, including the sleeping
+ * spinlocks of PREEMPT_RT.
+ */
+void wake_up_batch_begin(void)
+{
+	preempt_disable();
+	__this_cpu_inc(ttwu_batch_depth);
+}
+EXPORT_SYMBOL_GPL(wake_up_batch_begin);
+
+/**
+ * wake_up_batch_end - queue the wakeups held back since wake_up_batch_begin()
+ */
+void wake_up_batch_end(void)
+{
+	if (!__this_cpu_dec_return(ttwu_batch_depth))
+		ttwu_batch_flush();
+	preempt_enable();
 }
+EXPORT_SYMBOL_GPL(wake_up_batch_end);
 
 void wake_up_if_idle(int cpu)
 {
@@ -9974,6 +10041,7 @@ void __init sched_init(void)
 #ifdef CONFIG_FAIR_GROUP_SCHED
 		INIT_LIST_HEAD(&rq->leaf_cfs_rq_list);
 		rq->tmp_alone_branch = &rq->leaf_cfs_rq_list;
+		init_llist_head(&rq->lazy_cfs_rqs);
 		/*
 		 * How much CPU bandwidth does root_task_group get?
 		 *
@@ -115,6 +115,8 @@ static int sched_feat_set(char *cmp)
 	} else {
 		sysctl_sched_features |= (1UL << i);
 		sched_feat_enable(i);
+		if (i == __SCHED_FEAT_SIS_IDLE_MASK)
+			sched_idle_span_seed();
 	}
 
 	return 0;
@@ -4116,6 +4116,23 @@ static inline void update_tg_load_avg(struct cfs_rq *cfs_rq)
 	}
 }
 
+/* Same as update_tg_load_avg(), without the rate limit and threshold */
+static inline void sync_tg_load_avg(struct cfs_rq *cfs_rq)
+{
+	long delta;
+
+	if (cfs_rq->tg == &root_task_group)
+		return;
+
+	delta = cfs_rq->avg.load_avg - cfs_rq->tg_load_avg_contrib;
+	if (delta) {
+		atomic_long_add(delta, &cfs_rq->tg->load_avg);
+		cfs_rq->tg_load_avg_contrib = cfs_rq->avg.load_avg;
+		cfs_rq->last_update_tg_load_avg =
+			sched_clock_cpu(cpu_of(rq_of(cfs_rq)));
+	}
+}
+
 /*
  * Called within set_task_rq() right before setting a task's CPU. The
  * caller only guarantees p->pi_lock is held; no other assumptions,
@@ -4736,10 +4753,45 @@ static void sync_entity_load_avg(struct sched_entity *se)
  * Task first catches up with cfs_rq, and then subtract
  * itself from the cfs_rq (task must be off the queue now).
  */
+#ifdef CONFIG_FAIR_GROUP_SCHED
+/* cfs_rq->decay_lazy, see cfs_rq_decay_lazily() */
+#define LAZY_DECAY_NONE		0
+#define LAZY_DECAY_OFF_LIST	1
+#define LAZY_DECAY_QUEUED	2
+
+/*
+ * Called with cfs_rq->removed.lock held after adding to cfs_rq->removed:
+ * a lazily decayed cfs_rq must go back on the leaf list for the removed
+ * load to be processed. That takes the rq lock, which the caller may not
+ * hold, so tell it to queue the cfs_rq for relist_lazy_cfs_rqs().
+ */
+static inline bool cfs_rq_lazy_removed(struct cfs_rq *cfs_rq)
+{
+	if (cfs_rq->decay_lazy != LAZY_DECAY_OFF_LIST)
+		return false;
+
+	cfs_rq->decay_lazy = LAZY_DECAY_QUEUED;
+	return true;
+}
+
+static inline void queue_lazy_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	llist_add(&cfs_rq->lazy_node, &rq_of(cfs_rq)->lazy_cfs_rqs);
+}
+#else
+static inline bool cfs_rq_lazy_removed(struct cfs_rq *cfs_rq)
+{
+	return false;
+}
+
+static inline void queue_lazy_cfs_rq(struct cfs_rq *cfs_rq) { }
+#endif
+
 static void remove_entity_load_avg(struct sched_entity *se)
 {
 	struct cfs_rq *cfs_rq = cfs_rq_of(se);
 	unsigned long flags;
+	bool queue;
 
 	/*
 	 * tasks cannot exit without having gone through wake_up_new_task() ->
@@ -4754,7 +4806,11 @@ static void remove_entity_load_avg(struct sched_entity *se)
 	cfs_rq->removed.util_avg	+= se->avg.util_avg;
 	cfs_rq->removed.load_avg	+= se->avg.load_avg;
 	cfs_rq->removed.runnable_avg	+= se->avg.runnable_avg;
+	queue = cfs_rq_lazy_removed(cfs_rq);
 	raw_spin_unlock_irqrestore(&cfs_rq->removed.lock, flags);
+
+	if (queue)
+		queue_lazy_cfs_rq(cfs_rq);
 }
 
 static inline unsigned long cfs_rq_runnable_avg(struct cfs_rq *cfs_rq)
@@ -7221,7 +7277,7 @@ static inline bool test_idle_cores(int cpu)
 
 /*
  * Scans the local SMT mask to see if the entire core is idle, and records this
- * information in sd_llc_shared->has_idle_cores.
+ * information in sd_llc_shared->has_idle_cores and sds_idle_cores().
  *
  * Since SMT siblings share all cache levels, inspecting this limited remote
  * state should be fairly cheap.
@@ -7229,10 +7285,18 @@ static inline bool test_idle_cores(int cpu)
 void __update_idle_core(struct rq *rq)
 {
 	int core = cpu_of(rq);
+	int first = cpumask_first(cpu_smt_mask(core));
+	bool idle_mask = sched_feat(SIS_IDLE_MASK);
+	struct sched_domain_shared *sds;
 	int cpu;
 
 	rcu_read_lock();
-	if (test_idle_cores(core))
+	sds = rcu_dereference(per_cpu(sd_llc_shared, core));
+	if (!sds)
+		goto unlock;
+
+	if (READ_ONCE(sds->has_idle_cores) &&
+	    (!idle_mask || cpumask_test_cpu(first, sds_idle_cores(sds))))
 		goto unlock;
 
 	for_each_cpu(cpu, cpu_smt_mask(core)) {
@@ -7243,7 +7307,10 @@ void __update_idle_core(struct rq *rq)
 			goto unlock;
 	}
 
-	set_idle_cores(core, 1);
+	if (idle_mask && !cpumask_test_cpu(first, sds_idle_cores(sds)))
+		cpumask_set_cpu(first, sds_idle_cores(sds));
+	if (!READ_ONCE(sds->has_idle_cores))
+		WRITE_ONCE(sds->has_idle_cores, 1);
 unlock:
 	rcu_read_unlock();
 }
@@ -7321,6 +7388,123 @@ static inline int select_idle_smt(struct task_struct *p, int target)
 
 #endif /* CONFIG_SCHED_SMT */
 
+/*
+ * Track the idle CPUs and idle cores of the LLC on idle entry and exit, so
+ * that select_idle_cpu() only has to look at likely candidates.  The masks
+ * are hints: bits can be stale, and every candidate is re-checked before use.
+ *
+ * Every idle entry and exit is an atomic on a cacheline shared by the whole
+ * LLC, so this is only done with SIS_IDLE_MASK, and the masks are seeded by
+ * sched_idle_span_seed() when it is switched on.
+ */
+void update_idle_span(struct rq *rq, bool idle)
+{
+	struct sched_domain_shared *sds;
+	int cpu = cpu_of(rq);
+
+	if (!sched_feat(SIS_IDLE_MASK))
+		return;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (!sds)
+		goto unlock;
+
+	if (idle) {
+		if (!cpumask_test_cpu(cpu, sds_idle_cpus(sds)))
+			cpumask_set_cpu(cpu, sds_idle_cpus(sds));
+		goto unlock;
+	}
+
+	if (cpumask_test_cpu(cpu, sds_idle_cpus(sds)))
+		cpumask_clear_cpu(cpu, sds_idle_cpus(sds));
+#ifdef CONFIG_SCHED_SMT
+	if (static_branch_unlikely(&sched_smt_present)) {
+		int core = cpumask_first(cpu_smt_mask(cpu));
+
+		if (cpumask_test_cpu(core, sds_idle_cores(sds)))
+			cpumask_clear_cpu(core, sds_idle_cores(sds));
+	}
+#endif
+unlock:
+	rcu_read_unlock();
+}
+
+/*
+ * Rebuild the idle masks from the current state of every online CPU.  Called
+ * when SIS_IDLE_MASK is enabled, since nothing updated them while it was off.
+ * Races with concurrent idle entries and exits only leave stale hints.
+ */
+void sched_idle_span_seed(void)
+{
+	struct sched_domain_shared *sds;
+	int cpu;
+
+	rcu_read_lock();
+	for_each_online_cpu(cpu) {
+		sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+		if (!sds)
+			continue;
+
+		if (!available_idle_cpu(cpu)) {
+			cpumask_clear_cpu(cpu, sds_idle_cpus(sds));
+			continue;
+		}
+
+		cpumask_set_cpu(cpu, sds_idle_cpus(sds));
+		update_idle_core(cpu_rq(cpu));
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * SIS_IDLE_MASK variant of select_idle_cpu(): only visit the cores, then the
+ * CPUs, that update_idle_span() and __update_idle_core() reported as idle.
+ * Building the candidate masks still walks the LLC span a word at a time;
+ * what is saved is probing the runqueue of every CPU in it.
+ */
+static int select_idle_cpu_mask(struct task_struct *p, struct sched_domain *sd,
+				struct sched_domain_shared *sds,
+				bool has_idle_core, int target, int nr)
+{
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_rq_mask);
+	int i, cpu, core, idle_cpu = -1;
+
+	if (has_idle_core) {
+		cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
+
+		/*
+		 * A core is recorded by its first sibling, which @p may not
+		 * be allowed on while some other sibling is.
+		 */
+		for_each_cpu_wrap(core, sds_idle_cores(sds), target + 1) {
+			cpu = cpumask_first_and(cpu_smt_mask(core), cpus);
+			if (cpu >= nr_cpu_ids)
+				continue;
+			i = select_idle_core(p, cpu, cpus, &idle_cpu);
+			if ((unsigned int)i < nr_cpumask_bits)
+				return i;
+		}
+
+		set_idle_cores(target, false);
+		if ((unsigned int)idle_cpu < nr_cpumask_bits)
+			return idle_cpu;
+	}
+
+	cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
+	cpumask_and(cpus, cpus, sds_idle_cpus(sds));
+
+	for_each_cpu_wrap(cpu, cpus, target + 1) {
+		if (--nr <= 0)
+			return -1;
+		idle_cpu = __select_idle_cpu(cpu, p);
+		if ((unsigned int)idle_cpu < nr_cpumask_bits)
+			break;
+	}
+
+	return idle_cpu;
+}
+
 /*
  * Scan the LLC domain for idle CPUs; this is dynamically regulated by
  * comparing the average scan cost (tracked in sd->avg_scan_cost) against the
@@ -7345,6 +7529,14 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 		}
 	}
 
+	if (sched_feat(SIS_IDLE_MASK) &&
+	    !static_branch_unlikely(&sched_cluster_active)) {
+		sd_share = rcu_dereference(per_cpu(sd_llc_shared, target));
+		if (sd_share)
+			return select_idle_cpu_mask(p, sd, sd_share,
+						    has_idle_core, target, nr);
+	}
+
 	if (static_branch_unlikely(&sched_cluster_active)) {
 		struct sched_group *sg = sd->groups;
 
@@ -7734,12 +7926,20 @@ static unsigned long cpu_util_without(int cpu, struct task_struct *p)
  *                  contribution. Given by eenv_pd_busy_time().
  * @cpu_cap:        Maximum CPU capacity for the perf domain.
  * @pd_cap:         Entire perf domain capacity. (pd->nr_cpus * cpu_cap).
+ * @pd_max_util:    Highest CPU performance request of the perf domain without
+ *                  the task contribution. Given by eenv_pd_busy_time().
+ * @pd_max_util2:   Second highest one, used when the task is placed on
+ *                  @pd_max_cpu.
+ * @pd_max_cpu:     CPU requesting @pd_max_util.
  */
 struct energy_env {
 	unsigned long task_busy_time;
 	unsigned long pd_busy_time;
 	unsigned long cpu_cap;
 	unsigned long pd_cap;
+	unsigned long pd_max_util;
+	unsigned long pd_max_util2;
+	int pd_max_cpu;
 };
 
 /*
@@ -7762,6 +7962,44 @@ static inline void eenv_task_busy_time(struct energy_env *eenv,
 	eenv->task_busy_time = busy_time;
 }
 
+/*
+ * Compute the performance request of @cpu for compute_energy(), when the task
+ * @p is placed on @dst_cpu. The task only impacts the request of @dst_cpu:
+ * for every other CPU, this is the same whatever @dst_cpu is.
+ */
+static unsigned long
+eenv_cpu_perf(int cpu, struct task_struct *p, int dst_cpu)
+{
+	struct task_struct *tsk = (cpu == dst_cpu) ? p : NULL;
+	unsigned long util = cpu_util(cpu, p, dst_cpu, 1);
+	unsigned long eff_util, min, max;
+
+	/*
+	 * Performance domain frequency: utilization clamping
+	 * must be considered since it affects the selection
+	 * of the performance domain frequency.
+	 * NOTE: in case RT tasks are running, by default the
+	 * FREQUENCY_UTIL's utilization can be max OPP.
+	 */
+	eff_util = effective_cpu_util(cpu, util, &min, &max);
+
+	/* Task's uclamp can modify min and max value */
+	if (tsk && uclamp_is_used()) {
+		min = max(min, uclamp_eff_value(p, UCLAMP_MIN));
+
+		/*
+		 * If there is no active max uclamp constraint,
+		 * directly use task's one, otherwise keep max.
+		 */
+		if (uclamp_rq_is_idle(cpu_rq(cpu)))
+			max = uclamp_eff_value(p, UCLAMP_MAX);
+		else
+			max = max(max, uclamp_eff_value(p, UCLAMP_MAX));
+	}
+
+	return sugov_effective_cpu_perf(cpu, eff_util, min, max);
+}
+
 /*
  * Compute the perf_domain (PD) busy time for compute_energy(). Based on the
  * utilization for each @pd_cpus, it however doesn't take into account
@@ -7782,6 +8020,10 @@ static inline void eenv_task_busy_time(struct energy_env *eenv,
  *
  * Set @eenv busy time for the PD that spans @pd_cpus. This busy time can't
  * exceed @eenv->pd_cap.
+ *
+ * The same pass records the two highest CPU performance requests of the PD
+ * without @p, so that compute_energy() only has to evaluate the CPU the task
+ * is placed on, instead of walking the whole PD for every candidate.
  */
 static inline void eenv_pd_busy_time(struct energy_env *eenv,
 				     struct cpumask *pd_cpus,
@@ -7790,10 +8032,23 @@ static inline void eenv_pd_busy_time(struct energy_env *eenv,
 	unsigned long busy_time = 0;
 	int cpu;
 
+	eenv->pd_max_util = 0;
+	eenv->pd_max_util2 = 0;
+	eenv->pd_max_cpu = -1;
+
 	for_each_cpu(cpu, pd_cpus) {
 		unsigned long util = cpu_util(cpu, p, -1, 0);
+		unsigned long perf = eenv_cpu_perf(cpu, p, -1);
 
 		busy_time += effective_cpu_util(cpu, util, NULL, NULL);
+
+		if (eenv->pd_max_cpu < 0 || perf > eenv->pd_max_util) {
+			eenv->pd_max_util2 = eenv->pd_max_util;
+			eenv->pd_max_util = perf;
+			eenv->pd_max_cpu = cpu;
+		} else if (perf > eenv->pd_max_util2) {
+			eenv->pd_max_util2 = perf;
+		}
 	}
 
 	eenv->pd_busy_time = min(eenv->pd_cap, busy_time);
@@ -7801,48 +8056,21 @@ static inline void eenv_pd_busy_time(struct energy_env *eenv,
 
 /*
  * Compute the maximum utilization for compute_energy() when the task @p
- * is placed on the cpu @dst_cpu.
+ * is placed on the cpu @dst_cpu, which must belong to the PD last given to
+ * eenv_pd_busy_time().
  *
  * Returns the maximum utilization among @eenv->cpus. This utilization can't
  * exceed @eenv->cpu_cap.
  */
 static inline unsigned long
-eenv_pd_max_util(struct energy_env *eenv, struct cpumask *pd_cpus,
-		 struct task_struct *p, int dst_cpu)
+eenv_pd_max_util(struct energy_env *eenv, struct task_struct *p, int dst_cpu)
 {
-	unsigned long max_util = 0;
-	int cpu;
-
-	for_each_cpu(cpu, pd_cpus) {
-		struct task_struct *tsk = (cpu == dst_cpu) ? p : NULL;
-		unsigned long util = cpu_util(cpu, p, dst_cpu, 1);
-		unsigned long eff_util, min, max;
-
-		/*
-		 * Performance domain frequency: utilization clamping
-		 * must be considered since it affects the selection
-		 * of the performance domain frequency.
-		 * NOTE: in case RT tasks are running, by default the
-		 * FREQUENCY_UTIL's utilization can be max OPP.
-		 */
-		eff_util = effective_cpu_util(cpu, util, &min, &max);
-
-		/* Task's uclamp can modify min and max value */
-		if (tsk && uclamp_is_used()) {
-			min = max(min, uclamp_eff_value(p, UCLAMP_MIN));
+	unsigned long max_util = eenv->pd_max_util;
 
-			/*
-			 * If there is no active max uclamp constraint,
-			 * directly use task's one, otherwise keep max.
-			 */
-			if (uclamp_rq_is_idle(cpu_rq(cpu)))
-				max = uclamp_eff_value(p, UCLAMP_MAX);
-			else
-				max = max(max, uclamp_eff_value(p, UCLAMP_MAX));
-		}
-
-		eff_util = sugov_effective_cpu_perf(cpu, eff_util, min, max);
-		max_util = max(max_util, eff_util);
+	if (dst_cpu >= 0) {
+		if (dst_cpu == eenv->pd_max_cpu)
+			max_util = eenv->pd_max_util2;
+		max_util = max(max_util, eenv_cpu_perf(dst_cpu, p, dst_cpu));
 	}
 
 	return min(max_util, eenv->cpu_cap);
@@ -7855,9 +8083,9 @@ eenv_pd_max_util(struct energy_env *eenv, struct cpumask *pd_cpus,
  */
 static inline unsigned long
 compute_energy(struct energy_env *eenv, struct perf_domain *pd,
-	       struct cpumask *pd_cpus, struct task_struct *p, int dst_cpu)
+	       struct task_struct *p, int dst_cpu)
 {
-	unsigned long max_util = eenv_pd_max_util(eenv, pd_cpus, p, dst_cpu);
+	unsigned long max_util = eenv_pd_max_util(eenv, p, dst_cpu);
 	unsigned long busy_time = eenv->pd_busy_time;
 	unsigned long energy;
 
@@ -8034,12 +8262,11 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu)
 
 		eenv_pd_busy_time(&eenv, cpus, p);
 		/* Compute the 'base' energy of the pd, without @p */
-		base_energy = compute_energy(&eenv, pd, cpus, p, -1);
+		base_energy = compute_energy(&eenv, pd, p, -1);
 
 		/* Evaluate the energy impact of using prev_cpu. */
 		if (prev_spare_cap > -1) {
-			prev_delta = compute_energy(&eenv, pd, cpus, p,
-						    prev_cpu);
+			prev_delta = compute_energy(&eenv, pd, p, prev_cpu);
 			/* CPU utilization has changed */
 			if (prev_delta < base_energy)
 				goto unlock;
@@ -8062,7 +8289,7 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu)
 			    (cpu_thermal_cap <= best_thermal_cap))
 				continue;
 
-			cur_delta = compute_energy(&eenv, pd, cpus, p,
+			cur_delta = compute_energy(&eenv, pd, p,
 						   max_spare_cap_cpu);
 			/* CPU utilization has changed */
 			if (cur_delta < base_energy)
@@ -9274,12 +9501,97 @@ static bool __update_blocked_others(struct rq *rq, bool *done)
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 
+/*
+ * Blocked averages below this are not worth decaying every time the blocked
+ * load of the CPU is updated.
+ */
+#define LAZY_BLOCKED_AVG	(SCHED_CAPACITY_SCALE >> 6)
+
+/*
+ * With many cgroups, most leaf cfs_rqs of an idle CPU only carry the tail of
+ * some old activity, which takes a few hundred ms to decay to zero and is
+ * otherwise irrelevant. Once a blocked cfs_rq gets below LAZY_BLOCKED_AVG,
+ * drop it from the leaf list and let it decay lazily: the elapsed time is
+ * accounted for whenever it is updated next, on enqueue or attach. If load
+ * is removed from it meanwhile, by a task that migrates or dies, it is
+ * queued to go back on the list at the next update_blocked_averages().
+ *
+ * Marks the cfs_rq as lazily decayed when returning true.
+ */
+static inline bool cfs_rq_decay_lazily(struct cfs_rq *cfs_rq)
+{
+	bool ret = false;
+
+	if (!sched_feat(LAZY_BLOCKED_DECAY))
+		return false;
+
+	/* The root cfs_rq drives cpufreq and the nohz blocked load tracking */
+	if (cfs_rq == &rq_of(cfs_rq)->cfs)
+		return false;
+
+	if (cfs_rq->load.weight || cfs_rq->propagate)
+		return false;
+
+	if (cfs_rq->avg.load_avg >= LAZY_BLOCKED_AVG ||
+	    cfs_rq->avg.util_avg >= LAZY_BLOCKED_AVG ||
+	    cfs_rq->avg.runnable_avg >= LAZY_BLOCKED_AVG)
+		return false;
+
+	if (child_cfs_rq_on_list(cfs_rq))
+		return false;
+
+	/* Keep it listed while there is removed load to process */
+	raw_spin_lock(&cfs_rq->removed.lock);
+	if (!cfs_rq->removed.nr &&
+	    cfs_rq->decay_lazy != LAZY_DECAY_QUEUED) {
+		cfs_rq->decay_lazy = LAZY_DECAY_OFF_LIST;
+		ret = true;
+	}
+	raw_spin_unlock(&cfs_rq->removed.lock);
+
+	return ret;
+}
+
+/*
+ * Put the lazily decayed cfs_rqs which had load removed back on the leaf
+ * list, with their ancestors, for the removed load to be processed.
+ */
+static void relist_lazy_cfs_rqs(struct rq *rq)
+{
+	struct llist_node *list = llist_del_all(&rq->lazy_cfs_rqs);
+	struct cfs_rq *cfs_rq, *next;
+
+	llist_for_each_entry_safe(cfs_rq, next, list, lazy_node) {
+		struct sched_entity *se = cfs_rq->tg->se[cpu_of(rq)];
+
+		raw_spin_lock(&cfs_rq->removed.lock);
+		cfs_rq->decay_lazy = LAZY_DECAY_NONE;
+		raw_spin_unlock(&cfs_rq->removed.lock);
+
+		/* tg_unthrottle_up() puts it back */
+		if (throttled_hierarchy(cfs_rq))
+			continue;
+
+		if (list_add_leaf_cfs_rq(cfs_rq))
+			continue;
+
+		for_each_sched_entity(se) {
+			if (list_add_leaf_cfs_rq(cfs_rq_of(se)))
+				break;
+		}
+	}
+
+	assert_list_leaf_cfs_rq(rq);
+}
+
 static bool __update_blocked_fair(struct rq *rq, bool *done)
 {
 	struct cfs_rq *cfs_rq, *pos;
 	bool decayed = false;
 	int cpu = cpu_of(rq);
 
+	relist_lazy_cfs_rqs(rq);
+
 	/*
 	 * Iterates the task_group tree in a bottom up fashion, see
 	 * list_add_leaf_cfs_rq() for details.
@@ -9306,8 +9618,18 @@ static bool __update_blocked_fair(struct rq *rq, bool *done)
 		 * There can be a lot of idle CPU cgroups.  Don't let fully
 		 * decayed cfs_rqs linger on the list.
 		 */
-		if (cfs_rq_is_decayed(cfs_rq))
+		if (cfs_rq_is_decayed(cfs_rq)) {
+			list_del_leaf_cfs_rq(cfs_rq);
+		} else if (cfs_rq_decay_lazily(cfs_rq)) {
+			/*
+			 * Nobody refreshes tg->load_avg for it while it is off
+			 * the list: leave its actual load there, not a stale
+			 * one, until it is updated again.
+			 */
+			sync_tg_load_avg(cfs_rq);
 			list_del_leaf_cfs_rq(cfs_rq);
+			continue;
+		}
 
 		/* Don't need periodic decay once load/util_avg are null */
 		if (cfs_rq_has_blocked(cfs_rq))
@@ -12898,6 +13220,16 @@ void unregister_fair_sched_group(struct task_group *tg)
 		if (tg->se[cpu])
 			remove_entity_load_avg(tg->se[cpu]);
 
+#ifdef CONFIG_SMP
+		/* Not to be freed while queued to be relisted */
+		if (READ_ONCE(tg->cfs_rq[cpu]->decay_lazy) == LAZY_DECAY_QUEUED) {
+			rq = cpu_rq(cpu);
+			raw_spin_rq_lock_irqsave(rq, flags);
+			relist_lazy_cfs_rqs(rq);
+			raw_spin_rq_unlock_irqrestore(rq, flags);
+		}
+#endif
+
 		/*
 		 * Only empty task groups can be destroyed; so we can speculatively
 		 * check on_list without danger of it being re-added.
@@ -51,6 +51,20 @@ SCHED_FEAT(TTWU_QUEUE, true)
  */
 SCHED_FEAT(SIS_UTIL, true)
 
+/*
+ * Only scan the CPUs (or cores) of the LLC domain that are known to be
+ * idle, see update_idle_span(). Off by default: tracking them costs shared
+ * cacheline writes on every idle entry and exit.
+ */
+SCHED_FEAT(SIS_IDLE_MASK, false)
+
+/*
+ * Stop the periodic decay of nearly decayed blocked cfs_rqs, see
+ * cfs_rq_decay_lazily(). Off by default, compare with the
+ * cgroup_blocked_load sched selftest before turning it on.
+ */
+SCHED_FEAT(LAZY_BLOCKED_DECAY, false)
+
 /*
  * Issue a WARN when we do multiple update_rq_clock() calls
  * in a single rq->lock section. Default disabled because the
@@ -438,10 +438,12 @@ static void wakeup_preempt_idle(struct rq *rq, struct task_struct *p, int flags)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	update_idle_span(rq, false);
 }
 
 static void set_next_task_idle(struct rq *rq, struct task_struct *next, bool first)
 {
+	update_idle_span(rq, true);
 	update_idle_core(rq);
 	schedstat_inc(rq->sched_goidle);
 }
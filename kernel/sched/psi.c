@@ -135,6 +135,13 @@
  * This gives us an approximation of pressure that is practical
  * cost-wise, yet way more sensitive and accurate than periodic
  * sampling of the aggregate task states would be.
+ *
+ * A task change has to be accounted to the task's cgroup and to all
+ * of its ancestors. But as long as all the tasks of a CPU belong to
+ * the same cgroup, the ancestors see the very same task counts, hence
+ * the same states, as that cgroup on that CPU. The ancestors are then
+ * folded into it: only the cgroup is updated, and readers add its
+ * times to the ancestors' - see psi_fold().
  */
 
 static int psi_bug __read_mostly;
@@ -153,6 +160,17 @@ static int __init setup_psi(char *str)
 }
 __setup("psi=", setup_psi);
 
+static DEFINE_STATIC_KEY_FALSE(psi_fold_enabled);
+static bool psi_fold_enable;
+static int __init setup_psi_fold(char *str)
+{
+	return kstrtobool(str, &psi_fold_enable) == 0;
+}
+__setup("psi_fold=", setup_psi_fold);
+
+/* Group the ancestors are folded into on each CPU */
+static DEFINE_PER_CPU(struct psi_group *, psi_fold_group);
+
 /* Running averages - we need to be higher-res than loadavg */
 #define PSI_FREQ	(2*HZ+1)	/* 2 sec intervals */
 #define EXP_10s		1677		/* 1/exp(2s/10s) as fixed-point */
@@ -214,6 +232,9 @@ void __init psi_init(void)
 	if (!cgroup_psi_enabled())
 		static_branch_disable(&psi_cgroups_enabled);
 
+	if (psi_fold_enable)
+		static_branch_enable(&psi_fold_enabled);
+
 	psi_period = jiffies_to_nsecs(PSI_FREQ);
 	group_init(&psi_system);
 }
@@ -242,6 +263,31 @@ static bool test_state(unsigned int *tasks, enum psi_states state, bool oncpu)
 	}
 }
 
+/*
+ * The state of a group folded into @fold on this CPU is @fold's, and its
+ * times grew as much as @fold's since the folding started: they hold their
+ * value at that point minus @fold's then, see psi_fold().
+ */
+static void get_folded_state(struct psi_group_cpu *groupc,
+			     struct psi_group *fold, int cpu, u32 *times,
+			     u32 *state_mask, u64 *state_start,
+			     unsigned int *tasks)
+{
+	struct psi_group_cpu *foldc = per_cpu_ptr(fold->pcpu, cpu);
+	enum psi_states s;
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&foldc->seq);
+		for (s = 0; s < NR_PSI_STATES; s++)
+			times[s] = groupc->times[s] + foldc->times[s];
+		*state_mask = foldc->state_mask;
+		*state_start = foldc->state_start;
+		if (tasks)
+			memcpy(tasks, foldc->tasks, sizeof(foldc->tasks));
+	} while (read_seqcount_retry(&foldc->seq, seq));
+}
+
 static void get_recent_times(struct psi_group *group, int cpu,
 			     enum psi_aggregators aggregator, u32 *times,
 			     u32 *pchanged_states)
@@ -249,6 +295,7 @@ static void get_recent_times(struct psi_group *group, int cpu,
 	struct psi_group_cpu *groupc = per_cpu_ptr(group->pcpu, cpu);
 	int current_cpu = raw_smp_processor_id();
 	unsigned int tasks[NR_PSI_TASK_COUNTS];
+	struct psi_group *fold;
 	u64 now, state_start;
 	enum psi_states s;
 	unsigned int seq;
@@ -257,15 +304,31 @@ static void get_recent_times(struct psi_group *group, int cpu,
 	*pchanged_states = 0;
 
 	/* Snapshot a coherent view of the CPU state */
+	rcu_read_lock();
 	do {
 		seq = read_seqcount_begin(&groupc->seq);
 		now = cpu_clock(cpu);
+		if (groupc->state_mask & PSI_STATE_FOLDED) {
+			/*
+			 * psi_fold_group is set before, and cleared after, the
+			 * flags of the folded groups. Seeing it NULL means an
+			 * unfolding is under way, and the seqcount retries.
+			 */
+			smp_rmb();
+			fold = READ_ONCE(per_cpu(psi_fold_group, cpu));
+			if (fold)
+				get_folded_state(groupc, fold, cpu, times,
+						 &state_mask, &state_start,
+						 cpu == current_cpu ? tasks : NULL);
+			continue;
+		}
 		memcpy(times, groupc->times, sizeof(groupc->times));
 		state_mask = groupc->state_mask;
 		state_start = groupc->state_start;
 		if (cpu == current_cpu)
 			memcpy(tasks, groupc->tasks, sizeof(groupc->tasks));
 	} while (read_seqcount_retry(&groupc->seq, seq));
+	rcu_read_unlock();
 
 	/* Calculate state time deltas against the previous snapshot */
 	for (s = 0; s < NR_PSI_STATES; s++) {
@@ -764,6 +827,132 @@ static void record_times(struct psi_group_cpu *groupc, u64 now)
 		groupc->times[PSI_NONIDLE] += delta;
 }
 
+/*
+ * Fold the ancestors of @group into it on @cpu, if all the tasks of the
+ * CPU belong to @group (or its descendants): the ancestors then have the
+ * same task counts and states as @group, and their times grow alike. Until
+ * psi_unfold(), task changes only update @group, see psi_parent().
+ */
+static void psi_fold(struct psi_group *group, int cpu, u64 now)
+{
+	struct psi_group_cpu *groupc = per_cpu_ptr(group->pcpu, cpu);
+	struct psi_group_cpu *ancestorc;
+	struct psi_group *ancestor;
+	enum psi_states s;
+
+	if (!group->parent || !group->enabled)
+		return;
+
+	if (memcmp(groupc->tasks, per_cpu_ptr(psi_system.pcpu, cpu)->tasks,
+		   sizeof(groupc->tasks)))
+		return;
+
+	for (ancestor = group->parent; ancestor; ancestor = ancestor->parent)
+		if (!ancestor->enabled)
+			return;
+
+	write_seqcount_begin(&groupc->seq);
+	record_times(groupc, now);
+	write_seqcount_end(&groupc->seq);
+
+	/* Ordered before the flags by write_seqcount_begin() */
+	WRITE_ONCE(per_cpu(psi_fold_group, cpu), group);
+
+	for (ancestor = group->parent; ancestor; ancestor = ancestor->parent) {
+		ancestorc = per_cpu_ptr(ancestor->pcpu, cpu);
+
+		write_seqcount_begin(&ancestorc->seq);
+		record_times(ancestorc, now);
+		/* Keep the times relative to @group's, see get_folded_state() */
+		for (s = 0; s < NR_PSI_STATES; s++)
+			ancestorc->times[s] -= groupc->times[s];
+		ancestorc->state_mask |= PSI_STATE_FOLDED;
+		write_seqcount_end(&ancestorc->seq);
+	}
+}
+
+/* Bring the ancestors folded on @cpu up to date with the group */
+static void psi_unfold(int cpu)
+{
+	struct psi_group *group = per_cpu(psi_fold_group, cpu);
+	struct psi_group_cpu *groupc, *ancestorc;
+	struct psi_group *ancestor;
+	enum psi_states s;
+	u32 state_mask;
+
+	if (!group)
+		return;
+
+	groupc = per_cpu_ptr(group->pcpu, cpu);
+
+	for (ancestor = group->parent; ancestor; ancestor = ancestor->parent) {
+		ancestorc = per_cpu_ptr(ancestor->pcpu, cpu);
+
+		write_seqcount_begin(&ancestorc->seq);
+		for (s = 0; s < NR_PSI_STATES; s++)
+			ancestorc->times[s] += groupc->times[s];
+		memcpy(ancestorc->tasks, groupc->tasks, sizeof(groupc->tasks));
+
+		/*
+		 * Rebuild the states from the task counts, as
+		 * psi_group_change() would have. This also clears
+		 * PSI_STATE_FOLDED, but keeps the flags that aren't states.
+		 */
+		state_mask = groupc->state_mask & PSI_ONCPU;
+		if (ancestor->enabled) {
+			for (s = 0; s < NR_PSI_STATES; s++) {
+				if (test_state(ancestorc->tasks, s,
+					       state_mask & PSI_ONCPU))
+					state_mask |= (1 << s);
+			}
+			/* Reclaim on the CPU, see psi_group_change() */
+			state_mask |= groupc->state_mask & (1 << PSI_MEM_FULL);
+		}
+		state_mask |= ancestorc->state_mask & PSI_STATE_RESCHEDULE;
+		ancestorc->state_mask = state_mask;
+		ancestorc->state_start = groupc->state_start;
+		write_seqcount_end(&ancestorc->seq);
+	}
+
+	/* Ordered after the flags by write_seqcount_end() */
+	WRITE_ONCE(per_cpu(psi_fold_group, cpu), NULL);
+}
+
+/* A task of @group is about to change state on @cpu */
+static inline void psi_fold_prepare(struct psi_group *group, int cpu)
+{
+	struct psi_group *fold = per_cpu(psi_fold_group, cpu);
+
+	if (fold && fold != group)
+		psi_unfold(cpu);
+}
+
+/* A task of @group changed state on @cpu */
+static inline void psi_fold_update(struct psi_group *group, int cpu, u64 now)
+{
+	if (static_branch_likely(&psi_fold_enabled) &&
+	    !per_cpu(psi_fold_group, cpu))
+		psi_fold(group, cpu, now);
+}
+
+/* The ancestors folded into @group on @cpu don't need to be walked */
+static inline struct psi_group *psi_parent(struct psi_group *group, int cpu)
+{
+	if (per_cpu(psi_fold_group, cpu) == group)
+		return NULL;
+	return group->parent;
+}
+
+static void psi_group_kick(struct psi_group *group, u32 state_mask,
+			   bool wake_clock)
+{
+	if (state_mask & group->rtpoll_states)
+		psi_schedule_rtpoll_work(group, 1, false);
+
+	if (wake_clock && !delayed_work_pending(&group->avgs_work))
+		schedule_delayed_work(&group->avgs_work, PSI_FREQ);
+}
+
 static void psi_group_change(struct psi_group *group, int cpu,
 			     unsigned int clear, unsigned int set, u64 now,
 			     bool wake_clock)
@@ -863,11 +1052,13 @@ static void psi_group_change(struct psi_group *group, int cpu,
 
 	write_seqcount_end(&groupc->seq);
 
-	if (state_mask & group->rtpoll_states)
-		psi_schedule_rtpoll_work(group, 1, false);
+	psi_group_kick(group, state_mask, wake_clock);
 
-	if (wake_clock && !delayed_work_pending(&group->avgs_work))
-		schedule_delayed_work(&group->avgs_work, PSI_FREQ);
+	/* The folded ancestors changed state too, let them know */
+	if (per_cpu(psi_fold_group, cpu) == group) {
+		while ((group = group->parent))
+			psi_group_kick(group, state_mask, wake_clock);
+	}
 }
 
 static inline struct psi_group *task_psi_group(struct task_struct *task)
@@ -908,9 +1099,12 @@ void psi_task_change(struct task_struct *task, int clear, int set)
 	now = cpu_clock(cpu);
 
 	group = task_psi_group(task);
+	psi_fold_prepare(group, cpu);
 	do {
 		psi_group_change(group, cpu, clear, set, now, true);
-	} while ((group = group->parent));
+	} while ((group = psi_parent(group, cpu)));
+
+	psi_fold_update(task_psi_group(task), cpu, now);
 }
 
 void psi_task_switch(struct task_struct *prev, struct task_struct *next,
@@ -920,6 +1114,11 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 	int cpu = task_cpu(prev);
 	u64 now = cpu_clock(cpu);
 
+	if (next->pid)
+		psi_fold_prepare(task_psi_group(next), cpu);
+	if (prev->pid)
+		psi_fold_prepare(task_psi_group(prev), cpu);
+
 	if (next->pid) {
 		psi_flags_change(next, 0, TSK_ONCPU);
 		/*
@@ -936,7 +1135,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 			}
 
 			psi_group_change(group, cpu, 0, TSK_ONCPU, now, true);
-		} while ((group = group->parent));
+		} while ((group = psi_parent(group, cpu)));
 	}
 
 	if (prev->pid) {
@@ -974,7 +1173,7 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 			if (group == common)
 				break;
 			psi_group_change(group, cpu, clear, set, now, wake_clock);
-		} while ((group = group->parent));
+		} while ((group = psi_parent(group, cpu)));
 
 		/*
 		 * TSK_ONCPU is handled up to the common ancestor. If there are
@@ -984,10 +1183,15 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 		 */
 		if ((prev->psi_flags ^ next->psi_flags) & ~TSK_ONCPU) {
 			clear &= ~TSK_ONCPU;
-			for (; group; group = group->parent)
+			for (; group; group = psi_parent(group, cpu))
 				psi_group_change(group, cpu, clear, set, now, wake_clock);
 		}
 	}
+
+	if (next->pid)
+		psi_fold_update(task_psi_group(next), cpu, now);
+	else if (prev->pid)
+		psi_fold_update(task_psi_group(prev), cpu, now);
 }
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -1007,18 +1211,22 @@ void psi_account_irqtime(struct task_struct *task, u32 delta)
 	now = cpu_clock(cpu);
 
 	group = task_psi_group(task);
+	psi_fold_prepare(group, cpu);
 	do {
 		if (!group->enabled)
 			continue;
 
 		groupc = per_cpu_ptr(group->pcpu, cpu);
 
-		write_seqcount_begin(&groupc->seq);
+		/* Folded ancestors get the time through @task's group */
+		if (!(groupc->state_mask & PSI_STATE_FOLDED)) {
+			write_seqcount_begin(&groupc->seq);
 
-		record_times(groupc, now);
-		groupc->times[PSI_IRQ_FULL] += delta;
+			record_times(groupc, now);
+			groupc->times[PSI_IRQ_FULL] += delta;
 
-		write_seqcount_end(&groupc->seq);
+			write_seqcount_end(&groupc->seq);
+		}
 
 		if (group->rtpoll_states & (1 << PSI_IRQ_FULL))
 			psi_schedule_rtpoll_work(group, 1, false);
@@ -1110,9 +1318,34 @@ int psi_cgroup_alloc(struct cgroup *cgroup)
 
 void psi_cgroup_free(struct cgroup *cgroup)
 {
+	bool folded = false;
+	int cpu;
+
 	if (!static_branch_likely(&psi_cgroups_enabled))
 		return;
 
+	/*
+	 * The group has no tasks left, so the CPUs it is still folded into
+	 * are idle and nothing can fold ancestors into it anymore. Readers
+	 * of the ancestors may still be looking at it though.
+	 */
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+		struct rq_flags rf;
+
+		if (READ_ONCE(per_cpu(psi_fold_group, cpu)) != cgroup->psi)
+			continue;
+
+		rq_lock_irq(rq, &rf);
+		if (per_cpu(psi_fold_group, cpu) == cgroup->psi) {
+			psi_unfold(cpu);
+			folded = true;
+		}
+		rq_unlock_irq(rq, &rf);
+	}
+	if (folded)
+		synchronize_rcu();
+
 	cancel_delayed_work_sync(&cgroup->psi->avgs_work);
 	free_percpu(cgroup->psi->pcpu);
 	/* All triggers must be removed by now */
@@ -1197,26 +1430,27 @@ void psi_cgroup_restart(struct psi_group *group)
 	 * instead only stop test_state() loop, record_times()
 	 * and averaging worker, see psi_group_change() for details.
 	 *
-	 * When disable cgroup PSI, this function has nothing to sync
-	 * since cgroup pressure files are hidden and percpu psi_group_cpu
-	 * would see !psi_group->enabled and only do task accounting.
+	 * When disable cgroup PSI, this function only has to unfold the
+	 * ancestors: cgroup pressure files are hidden and percpu
+	 * psi_group_cpu would see !psi_group->enabled and only do task
+	 * accounting, but folded groups would keep accumulating times.
 	 *
 	 * When re-enable cgroup PSI, this function use psi_group_change()
 	 * to get correct state mask from test_state() loop on tasks[],
 	 * and restart groupc->state_start from now, use .clear = .set = 0
 	 * here since no task status really changed.
 	 */
-	if (!group->enabled)
-		return;
-
 	for_each_possible_cpu(cpu) {
 		struct rq *rq = cpu_rq(cpu);
 		struct rq_flags rf;
 		u64 now;
 
 		rq_lock_irq(rq, &rf);
-		now = cpu_clock(cpu);
-		psi_group_change(group, cpu, 0, 0, now, true);
+		psi_unfold(cpu);
+		if (group->enabled) {
+			now = cpu_clock(cpu);
+			psi_group_change(group, cpu, 0, 0, now, true);
+		}
 		rq_unlock_irq(rq, &rf);
 	}
 }
@@ -624,6 +624,10 @@ struct cfs_rq {
 	long			propagate;
 	long			prop_runnable_sum;
 
+	/* Off the leaf list to decay lazily, under removed.lock */
+	int			decay_lazy;
+	struct llist_node	lazy_node;
+
 	/*
 	 *   h_load = weight * f(tg)
 	 *
@@ -1020,6 +1024,8 @@ struct rq {
 	/* list of leaf cfs_rq on this CPU: */
 	struct list_head	leaf_cfs_rq_list;
 	struct list_head	*tmp_alone_branch;
+	/* lazily decayed cfs_rq with load removed since, to relist */
+	struct llist_head	lazy_cfs_rqs;
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 	/*
@@ -1429,6 +1435,14 @@ static inline void update_idle_core(struct rq *rq)
 static inline void update_idle_core(struct rq *rq) { }
 #endif
 
+#ifdef CONFIG_SMP
+extern void update_idle_span(struct rq *rq, bool idle);
+extern void sched_idle_span_seed(void);
+#else
+static inline void update_idle_span(struct rq *rq, bool idle) { }
+static inline void sched_idle_span_seed(void) { }
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 static inline struct task_struct *task_of(struct sched_entity *se)
 {
@@ -1899,6 +1913,16 @@ static __always_inline bool sched_asym_cpucap_active(void)
 	return static_branch_unlikely(&sched_asym_cpucapacity);
 }
 
+static inline struct cpumask *sds_idle_cpus(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_span);
+}
+
+static inline struct cpumask *sds_idle_cores(struct sched_domain_shared *sds)
+{
+	return (struct cpumask *)((void *)sds->idle_span + cpumask_size());
+}
+
 struct sched_group_capacity {
 	atomic_t		ref;
 	/*
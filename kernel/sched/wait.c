@@ -101,10 +101,20 @@ static int __wake_up_common_lock(struct wait_queue_head *wq_head, unsigned int m
 {
 	unsigned long flags;
 	int remaining;
+	/*
+	 * Send the IPIs for a wake-many in one go. The batch disables
+	 * preemption, which the wake functions run under the sleeping
+	 * wq_head->lock of PREEMPT_RT can't live with.
+	 */
+	bool batch = !IS_ENABLED(CONFIG_PREEMPT_RT) && nr_exclusive != 1;
 
 	spin_lock_irqsave(&wq_head->lock, flags);
+	if (batch)
+		wake_up_batch_begin();
 	remaining = __wake_up_common(wq_head, mode, nr_exclusive, wake_flags,
 			key);
+	if (batch)
+		wake_up_batch_end();
 	spin_unlock_irqrestore(&wq_head->lock, flags);
 
 	return nr_exclusive - remaining;
@@ -40,6 +40,7 @@ struct call_function_data {
 	call_single_data_t	__percpu *csd;
 	cpumask_var_t		cpumask;
 	cpumask_var_t		cpumask_ipi;
+	cpumask_var_t		cpumask_deferred;
 };
 
 static DEFINE_PER_CPU_ALIGNED(struct call_function_data, cfd_data);
@@ -62,10 +63,17 @@ int smpcfd_prepare_cpu(unsigned int cpu)
 		free_cpumask_var(cfd->cpumask);
 		return -ENOMEM;
 	}
+	if (!zalloc_cpumask_var_node(&cfd->cpumask_deferred, GFP_KERNEL,
+				     cpu_to_node(cpu))) {
+		free_cpumask_var(cfd->cpumask);
+		free_cpumask_var(cfd->cpumask_ipi);
+		return -ENOMEM;
+	}
 	cfd->csd = alloc_percpu(call_single_data_t);
 	if (!cfd->csd) {
 		free_cpumask_var(cfd->cpumask);
 		free_cpumask_var(cfd->cpumask_ipi);
+		free_cpumask_var(cfd->cpumask_deferred);
 		return -ENOMEM;
 	}
 
@@ -78,6 +86,7 @@ int smpcfd_dead_cpu(unsigned int cpu)
 
 	free_cpumask_var(cfd->cpumask);
 	free_cpumask_var(cfd->cpumask_ipi);
+	free_cpumask_var(cfd->cpumask_deferred);
 	free_percpu(cfd->csd);
 	return 0;
 }
@@ -382,6 +391,66 @@ void __smp_call_single_queue(int cpu, struct llist_node *node)
 		send_call_function_single_ipi(cpu);
 }
 
+/*
+ * Like __smp_call_single_queue(), but instead of sending the IPI right away
+ * record @cpu in this CPU's deferred mask; smp_send_deferred_call_ipis()
+ * then kicks all the recorded CPUs at once, with a single multicast IPI
+ * where the architecture supports it.
+ *
+ * Only the CPU that made the queue non-empty is responsible for the IPI,
+ * so other CPUs queueing to @cpu in the meantime rely on the deferred one:
+ * the caller must keep preemption disabled until the IPIs are sent and
+ * must not do anything but queue more entries before sending them.
+ */
+void __smp_call_single_queue_deferred(int cpu, struct llist_node *node)
+{
+	struct call_function_data *cfd = this_cpu_ptr(&cfd_data);
+
+	if (trace_csd_queue_cpu_enabled()) {
+		call_single_data_t *csd;
+		smp_call_func_t func;
+
+		csd = container_of(node, call_single_data_t, node.llist);
+		func = CSD_TYPE(csd) == CSD_TYPE_TTWU ?
+			sched_ttwu_pending : csd->func;
+
+		trace_csd_queue_cpu(cpu, _RET_IP_, func, csd);
+	}
+
+	if (llist_add(node, &per_cpu(call_single_queue, cpu)))
+		__cpumask_set_cpu(cpu, cfd->cpumask_deferred);
+}
+
+/*
+ * Send the IPIs recorded by __smp_call_single_queue_deferred() on this CPU.
+ * Must be called from the same preemption-disabled section.
+ */
+void smp_send_deferred_call_ipis(void)
+{
+	struct call_function_data *cfd = this_cpu_ptr(&cfd_data);
+	unsigned int cpu, last_cpu = 0, nr_cpus = 0;
+
+	for_each_cpu(cpu, cfd->cpumask_deferred) {
+		/* Polling idle CPUs notice the queue without an interrupt */
+		if (!call_function_single_prep_ipi(cpu)) {
+			__cpumask_clear_cpu(cpu, cfd->cpumask_deferred);
+			continue;
+		}
+		nr_cpus++;
+		last_cpu = cpu;
+	}
+
+	if (nr_cpus == 1) {
+		trace_ipi_send_cpu(last_cpu, _RET_IP_,
+				   generic_smp_call_function_single_interrupt);
+		arch_send_call_function_single_ipi(last_cpu);
+	} else if (nr_cpus > 1) {
+		send_call_function_ipi_mask(cfd->cpumask_deferred);
+	}
+
+	cpumask_clear(cfd->cpumask_deferred);
+}
+
 /*
  * Insert a previously allocated call_single_data_t element
  * for execution on the given CPU. data must already have
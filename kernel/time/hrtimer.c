@@ -640,6 +640,46 @@ static inline ktime_t hrtimer_update_base(struct hrtimer_cpu_base *base)
 	return now;
 }
 
+/*
+ * Slack-aware coalescing across the clock bases of a CPU: an interrupt
+ * programmed for a timer of the hard bases also raises the softirq when the
+ * slack window of a timer of the softirq bases is open already, instead of
+ * leaving it to an interrupt programmed for its hard expiry.
+ */
+static bool hrtimer_coalesce __read_mostly;
+
+static int __init setup_hrtimer_coalesce(char *str)
+{
+	return (kstrtobool(str, &hrtimer_coalesce) == 0);
+}
+
+__setup("hrtimer_coalesce=", setup_hrtimer_coalesce);
+
+/*
+ * Check whether the first timer of a softirq clock base may be expired at
+ * @now. Timers further down a queue are not looked at: their hard expiry
+ * is later, so they are expired at the latest along with the first one.
+ */
+static bool hrtimer_softirq_window_open(struct hrtimer_cpu_base *cpu_base,
+					ktime_t now)
+{
+	unsigned int active = cpu_base->active_bases & HRTIMER_ACTIVE_SOFT;
+	struct hrtimer_clock_base *base;
+
+	if (!hrtimer_coalesce || cpu_base->softirq_activated)
+		return false;
+
+	for_each_active_base(base, cpu_base, active) {
+		struct timerqueue_node *next = timerqueue_getnext(&base->active);
+		struct hrtimer *timer = container_of(next, struct hrtimer, node);
+
+		if (ktime_add(now, base->offset) >=
+		    hrtimer_get_softexpires_tv64(timer))
+			return true;
+	}
+	return false;
+}
+
 /*
  * Is the high resolution mode active ?
  */
@@ -1749,6 +1789,10 @@ static void __hrtimer_run_queues(struct hrtimer_cpu_base *cpu_base, ktime_t now,
 			if (basenow < hrtimer_get_softexpires_tv64(timer))
 				break;
 
+			/* Expired within its slack by an earlier interrupt */
+			if (basenow < hrtimer_get_expires_tv64(timer))
+				cpu_base->nr_coalesced++;
+
 			__run_hrtimer(cpu_base, base, timer, &basenow, flags);
 			if (active_mask == HRTIMER_ACTIVE_SOFT)
 				hrtimer_sync_wait_running(cpu_base, flags);
@@ -1805,7 +1849,8 @@ void hrtimer_interrupt(struct clock_event_device *dev)
 	 */
 	cpu_base->expires_next = KTIME_MAX;
 
-	if (!ktime_before(now, cpu_base->softirq_expires_next)) {
+	if (!ktime_before(now, cpu_base->softirq_expires_next) ||
+	    hrtimer_softirq_window_open(cpu_base, now)) {
 		cpu_base->softirq_expires_next = KTIME_MAX;
 		cpu_base->softirq_activated = 1;
 		raise_softirq_irqoff(HRTIMER_SOFTIRQ);
@@ -1918,7 +1963,8 @@ void hrtimer_run_queues(void)
 	raw_spin_lock_irqsave(&cpu_base->lock, flags);
 	now = hrtimer_update_base(cpu_base);
 
-	if (!ktime_before(now, cpu_base->softirq_expires_next)) {
+	if (!ktime_before(now, cpu_base->softirq_expires_next) ||
+	    hrtimer_softirq_window_open(cpu_base, now)) {
 		cpu_base->softirq_expires_next = KTIME_MAX;
 		cpu_base->softirq_activated = 1;
 		raise_softirq_irqoff(HRTIMER_SOFTIRQ);
@@ -163,8 +163,41 @@ static inline void timers_update_nohz(void) { }
 DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
+extern u64 timer_base_try_to_set_idle(unsigned long basej, u64 basem,
+				      bool *idle);
 void timer_clear_idle(void);
 
+/**
+ * struct timer_events - first local and global timer of a CPU
+ * @local:	Expiry of the first pinned timer, KTIME_MAX if none
+ * @global:	Expiry of the first global timer, KTIME_MAX if none or if
+ *		a pinned timer expires first
+ */
+struct timer_events {
+	u64	local;
+	u64	global;
+};
+
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+extern u64 get_jiffies_update(unsigned long *basej);
+extern u64 fetch_next_timer_interrupt_remote(unsigned long basej, u64 basem,
+					     unsigned int cpu);
+extern void timer_lock_remote_bases(unsigned int cpu);
+extern void timer_unlock_remote_bases(unsigned int cpu);
+extern void timer_expire_remote(unsigned int cpu);
+
+extern void tmigr_handle_remote(void);
+extern bool tmigr_requires_handle_remote(void);
+extern void tmigr_cpu_activate(void);
+extern u64 tmigr_cpu_deactivate(u64 nextexp);
+extern u64 tmigr_cpu_new_timer(u64 nextexp);
+extern u64 tmigr_quick_check(u64 nextexp);
+#else
+static inline void tmigr_handle_remote(void) { }
+static inline bool tmigr_requires_handle_remote(void) { return false; }
+static inline void tmigr_cpu_activate(void) { }
+#endif
+
 #define CLOCK_SET_WALL							\
 	(BIT(HRTIMER_BASE_REALTIME) | BIT(HRTIMER_BASE_REALTIME_SOFT) |	\
 	 BIT(HRTIMER_BASE_TAI) | BIT(HRTIMER_BASE_TAI_SOFT))
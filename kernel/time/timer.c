@@ -181,18 +181,25 @@ EXPORT_SYMBOL(jiffies_64);
 #define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
 
 /*
- * The resulting wheel size. If NOHZ is configured we allocate two
- * wheels so we have a separate storage for the deferrable timers.
+ * The resulting wheel size. If NOHZ is configured we allocate three
+ * wheels: the pinned timers, the global timers which can be expired by
+ * any CPU when the owner is idle, and the deferrable timers.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 #ifdef CONFIG_NO_HZ_COMMON
-# define NR_BASES	2
-# define BASE_STD	0
-# define BASE_DEF	1
+/*
+ * If multiple bases need to be locked, use the base ordering for lock
+ * nesting, i.e. lowest number first.
+ */
+# define NR_BASES	3
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
 #else
 # define NR_BASES	1
-# define BASE_STD	0
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -586,8 +593,11 @@ trigger_dyntick_cpu(struct timer_base *base, struct timer_list *timer)
 
 	/*
 	 * We might have to IPI the remote CPU if the base is idle and the
-	 * timer is not deferrable. If the other CPU is on the way to idle
-	 * then it can't set base->is_idle as we hold the base lock:
+	 * timer is not deferrable: a pinned timer, or a global timer queued
+	 * there by a nohz_full CPU or while it was running. The woken CPU
+	 * hands its new first global timer over to the hierarchy. If the other
+	 * CPU is on the way to idle then it can't set base->is_idle as we hold
+	 * the base lock:
 	 */
 	if (base->is_idle)
 		wake_up_nohz_cpu(base->cpu);
@@ -902,28 +912,30 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 
 static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 {
-	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_STD], cpu);
+	int index = tflags & TIMER_PINNED ? BASE_LOCAL : BASE_GLOBAL;
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
 	 * to use the deferrable base.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = per_cpu_ptr(&timer_bases[BASE_DEF], cpu);
-	return base;
+		index = BASE_DEF;
+
+	return per_cpu_ptr(&timer_bases[index], cpu);
 }
 
 static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	int index = tflags & TIMER_PINNED ? BASE_LOCAL : BASE_GLOBAL;
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
 	 * to use the deferrable base.
 	 */
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && (tflags & TIMER_DEFERRABLE))
-		base = this_cpu_ptr(&timer_bases[BASE_DEF]);
-	return base;
+		index = BASE_DEF;
+
+	return this_cpu_ptr(&timer_bases[index]);
 }
 
 static inline struct timer_base *get_timer_base(u32 tflags)
@@ -931,12 +943,18 @@ static inline struct timer_base *get_timer_base(u32 tflags)
 	return get_timer_cpu_base(tflags, tflags & TIMER_CPUMASK);
 }
 
+/*
+ * Timers are queued on the local CPU. When the CPU goes idle, its global
+ * timers are expired by an active CPU through the timer migration
+ * hierarchy instead. nohz_full CPUs are not part of the hierarchy, so their
+ * non pinned timers still go to a housekeeping CPU.
+ */
 static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
-#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_FULL)
 	if (static_branch_likely(&timers_migration_enabled) &&
-	    !(tflags & TIMER_PINNED))
+	    !(tflags & TIMER_PINNED) && tick_nohz_full_cpu(smp_processor_id()))
 		return get_timer_cpu_base(tflags, get_nohz_timer_target());
 #endif
 	return get_timer_this_cpu_base(tflags);
@@ -1264,7 +1282,8 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	if (WARN_ON_ONCE(timer_pending(timer)))
 		return;
 
-	new_base = get_timer_cpu_base(timer->flags, cpu);
+	/* The timer has to stay on @cpu, even when @cpu goes idle */
+	new_base = get_timer_cpu_base(timer->flags | TIMER_PINNED, cpu);
 
 	/*
 	 * If @timer was on a different CPU, it should be migrated with the
@@ -1286,7 +1305,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 		base = new_base;
 		raw_spin_lock(&base->lock);
 		WRITE_ONCE(timer->flags,
-			   (timer->flags & ~TIMER_BASEMASK) | cpu);
+			   (timer->flags & ~TIMER_BASEMASK) | cpu | TIMER_PINNED);
 	}
 	forward_timer_base(base);
 
@@ -1910,65 +1929,250 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
 	return DIV_ROUND_UP_ULL(nextevt, TICK_NSEC) * TICK_NSEC;
 }
 
+static unsigned long next_timer_interrupt(struct timer_base *base,
+					  unsigned long basej)
+{
+	if (base->next_expiry_recalc)
+		base->next_expiry = __next_timer_interrupt(base);
+
+	/*
+	 * We have a fresh next event. Check whether we can forward the
+	 * base. We can only do that when @basej is past base->clk
+	 * otherwise we might rewind base->clk.
+	 */
+	if (time_after(basej, base->clk)) {
+		if (time_after(base->next_expiry, basej))
+			base->clk = basej;
+		else if (time_after(base->next_expiry, base->clk))
+			base->clk = base->next_expiry;
+	}
+
+	return base->next_expiry;
+}
+
+static inline u64 timer_expiry_ns(unsigned long nextevt, unsigned long basej,
+				  u64 basem)
+{
+	if (time_before_eq(nextevt, basej))
+		return basem;
+
+	return basem + (u64)(nextevt - basej) * TICK_NSEC;
+}
+
+/*
+ * Fetch the first local and global timer of the CPU owning @base_local and
+ * @base_global, whose locks are held, into @tevt. The global timer is left
+ * out when a local timer expires first: the CPU has to wake up anyway, and
+ * reevaluates its global timers then. Returns the first of both in jiffies.
+ */
+static unsigned long fetch_next_timer_interrupt(unsigned long basej, u64 basem,
+						struct timer_base *base_local,
+						struct timer_base *base_global,
+						struct timer_events *tevt)
+{
+	unsigned long nextevt, nextevt_local, nextevt_global;
+	bool local_first;
+
+	nextevt_local = next_timer_interrupt(base_local, basej);
+	nextevt_global = next_timer_interrupt(base_global, basej);
+
+	local_first = time_before_eq(nextevt_local, nextevt_global);
+	nextevt = local_first ? nextevt_local : nextevt_global;
+
+	tevt->local = tevt->global = KTIME_MAX;
+	if (base_local->timers_pending)
+		tevt->local = timer_expiry_ns(nextevt_local, basej, basem);
+	if (!local_first && base_global->timers_pending)
+		tevt->global = timer_expiry_ns(nextevt_global, basej, basem);
+
+	return nextevt;
+}
+
+#ifdef CONFIG_SMP
 /**
- * get_next_timer_interrupt - return the time (clock mono) of the next timer
+ * fetch_next_timer_interrupt_remote - return the first global timer of a CPU
  * @basej:	base time jiffies
  * @basem:	base time clock monotonic
+ * @cpu:	Remote CPU
  *
- * Returns the tick aligned clock monotonic time of the next pending
- * timer or KTIME_MAX if no timer is pending.
+ * Used by the timer migration code after expiring the global timers of an
+ * idle CPU. Must be called with the timer bases of @cpu locked, see
+ * timer_lock_remote_bases().
  */
-u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
+u64 fetch_next_timer_interrupt_remote(unsigned long basej, u64 basem,
+				      unsigned int cpu)
+{
+	struct timer_base *base_local, *base_global;
+	struct timer_events tevt;
+
+	base_local = per_cpu_ptr(&timer_bases[BASE_LOCAL], cpu);
+	base_global = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+
+	lockdep_assert_held(&base_local->lock);
+	lockdep_assert_held(&base_global->lock);
+
+	fetch_next_timer_interrupt(basej, basem, base_local, base_global, &tevt);
+
+	return tevt.global;
+}
+
+/**
+ * timer_lock_remote_bases - lock the timer bases of a CPU
+ * @cpu:	Remote CPU
+ *
+ * Called with interrupts disabled.
+ */
+void timer_lock_remote_bases(unsigned int cpu)
+	__acquires(timer_bases[BASE_LOCAL]->lock)
+	__acquires(timer_bases[BASE_GLOBAL]->lock)
+{
+	struct timer_base *base_local, *base_global;
+
+	base_local = per_cpu_ptr(&timer_bases[BASE_LOCAL], cpu);
+	base_global = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+
+	lockdep_assert_irqs_disabled();
+
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+}
+
+/**
+ * timer_unlock_remote_bases - unlock the timer bases of a CPU
+ * @cpu:	Remote CPU
+ */
+void timer_unlock_remote_bases(unsigned int cpu)
+	__releases(timer_bases[BASE_LOCAL]->lock)
+	__releases(timer_bases[BASE_GLOBAL]->lock)
+{
+	struct timer_base *base_local, *base_global;
+
+	base_local = per_cpu_ptr(&timer_bases[BASE_LOCAL], cpu);
+	base_global = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
+}
+
+/*
+ * Hand the first global timer over to the timer migration hierarchy and
+ * return the first event this CPU has to wake up for. With timer migration
+ * disabled, the CPU expires its global timers itself; it still tells the
+ * hierarchy that it is idle, so that no timer of an idle CPU waits for it.
+ */
+static u64 timer_use_tmigr(struct timer_events *tevt, bool go_idle,
+			   bool base_idle)
+{
+	u64 handoff = tevt->global, keep = KTIME_MAX, next;
+
+	if (!static_branch_likely(&timers_migration_enabled)) {
+		keep = handoff;
+		handoff = KTIME_MAX;
+	}
+
+	if (go_idle)
+		next = tmigr_cpu_deactivate(handoff);
+	else if (base_idle)
+		next = tmigr_cpu_new_timer(handoff);
+	else
+		next = tmigr_quick_check(handoff);
+
+	return min3(tevt->local, keep, next);
+}
+#else
+static u64 timer_use_tmigr(struct timer_events *tevt, bool go_idle,
+			   bool base_idle)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-	u64 expires = KTIME_MAX;
+	return min(tevt->local, tevt->global);
+}
+#endif
+
+static u64 __get_next_timer_interrupt(unsigned long basej, u64 basem,
+				      bool *idle)
+{
+	struct timer_base *base_local = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	struct timer_base *base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+	struct timer_events tevt;
 	unsigned long nextevt;
+	bool go_idle = false;
+	u64 expires;
 
 	/*
 	 * Pretend that there is no timer pending if the cpu is offline.
 	 * Possible pending timers will be migrated later to an active cpu.
 	 */
-	if (cpu_is_offline(smp_processor_id()))
-		return expires;
+	if (cpu_is_offline(smp_processor_id())) {
+		if (idle)
+			*idle = true;
+		return KTIME_MAX;
+	}
 
-	raw_spin_lock(&base->lock);
-	if (base->next_expiry_recalc)
-		base->next_expiry = __next_timer_interrupt(base);
-	nextevt = base->next_expiry;
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+
+	nextevt = fetch_next_timer_interrupt(basej, basem, base_local,
+					     base_global, &tevt);
 
 	/*
-	 * We have a fresh next event. Check whether we can forward the
-	 * base. We can only do that when @basej is past base->clk
-	 * otherwise we might rewind base->clk.
+	 * If we expect to sleep more than a tick, mark the base idle.
+	 * Also the tick is stopped so any added timer must forward the base
+	 * clk itself to keep granularity small. This idle logic is only
+	 * maintained for the BASE_LOCAL and BASE_GLOBAL bases, deferrable
+	 * timers may still see large granularity skew (by design).
 	 */
-	if (time_after(basej, base->clk)) {
-		if (time_after(nextevt, basej))
-			base->clk = basej;
-		else if (time_after(nextevt, base->clk))
-			base->clk = nextevt;
+	if (idle) {
+		go_idle = time_after(nextevt, basej + 1);
+		if (go_idle) {
+			base_local->is_idle = true;
+			base_global->is_idle = true;
+		}
+		*idle = go_idle;
 	}
 
-	if (time_before_eq(nextevt, basej)) {
-		expires = basem;
-		base->is_idle = false;
-	} else {
-		if (base->timers_pending)
-			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
-		/*
-		 * If we expect to sleep more than a tick, mark the base idle.
-		 * Also the tick is stopped so any added timer must forward
-		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
-		 */
-		if ((expires - basem) > TICK_NSEC)
-			base->is_idle = true;
-	}
-	raw_spin_unlock(&base->lock);
+	expires = timer_use_tmigr(&tevt, go_idle, base_local->is_idle);
+
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
 
+/**
+ * get_next_timer_interrupt - return the time (clock mono) of the next timer
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ *
+ * Returns the tick aligned clock monotonic time of the next pending
+ * timer or KTIME_MAX if no timer is pending. If timer of global base was
+ * queued into timer migration hierarchy, first global timer is not taken
+ * into account. If it was the last CPU of timer migration hierarchy going
+ * idle, first global event is taken into account.
+ */
+u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
+{
+	return __get_next_timer_interrupt(basej, basem, NULL);
+}
+
+/**
+ * timer_base_try_to_set_idle - try to set the idle state of the timer bases
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ * @idle:	pointer to store the value of timer_base->is_idle on return;
+ *		*idle contains the information whether tick was already
+ *		stopped
+ *
+ * Returns the tick aligned clock monotonic time of the next pending timer
+ * or KTIME_MAX if no timer is pending. When tick was already stopped
+ * KTIME_MAX is returned as well.
+ */
+u64 timer_base_try_to_set_idle(unsigned long basej, u64 basem, bool *idle)
+{
+	if (*idle)
+		return KTIME_MAX;
+
+	return __get_next_timer_interrupt(basej, basem, idle);
+}
+
 /**
  * timer_clear_idle - Clear the idle state of the timer base
  *
@@ -1976,15 +2180,17 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
-	 * We do this unlocked. The worst outcome is a remote enqueue sending
-	 * a pointless IPI, but taking the lock would just make the window for
-	 * sending the IPI a few instructions smaller for the cost of taking
-	 * the lock in the exit from idle path.
+	 * We do this unlocked. The worst outcome is a remote pinned timer
+	 * enqueue sending a pointless IPI, but taking the lock would just
+	 * make the window for sending the IPI a few instructions smaller
+	 * for the cost of taking the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	__this_cpu_write(timer_bases[BASE_LOCAL].is_idle, false);
+	__this_cpu_write(timer_bases[BASE_GLOBAL].is_idle, false);
+
+	/* The CPU expires its global timers itself again */
+	tmigr_cpu_activate();
 }
 #endif
 
@@ -2003,6 +2209,14 @@ static inline void __run_timers(struct timer_base *base)
 	timer_base_lock_expiry(base);
 	raw_spin_lock_irq(&base->lock);
 
+	/*
+	 * The global base of an idle CPU may be expired by another CPU
+	 * through the timer migration hierarchy. Don't run it concurrently:
+	 * the one already expiring it takes care of the remaining timers.
+	 */
+	if (base->running_timer)
+		goto out_unlock;
+
 	while (time_after_eq(jiffies, base->clk) &&
 	       time_after_eq(jiffies, base->next_expiry)) {
 		levels = collect_expired_timers(base, heads);
@@ -2021,20 +2235,38 @@ static inline void __run_timers(struct timer_base *base)
 		while (levels--)
 			expire_timers(base, heads + levels);
 	}
+out_unlock:
 	raw_spin_unlock_irq(&base->lock);
 	timer_base_unlock_expiry(base);
 }
 
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	Remote CPU
+ *
+ * Called by the timer migration code from the timer softirq of the CPU
+ * which expires the timers of the idle @cpu.
+ */
+void timer_expire_remote(unsigned int cpu)
+{
+	__run_timers(per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu));
+}
+#endif
+
 /*
  * This function runs timers and the timer-tq in bottom half context.
  */
 static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
-	__run_timers(base);
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON))
+	__run_timers(this_cpu_ptr(&timer_bases[BASE_LOCAL]));
+	if (IS_ENABLED(CONFIG_NO_HZ_COMMON)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
+
+		if (is_timers_nohz_active())
+			tmigr_handle_remote();
+	}
 }
 
 /*
@@ -2042,19 +2274,24 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
  */
 static void run_local_timers(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	int i;
 
 	hrtimer_run_queues();
+
 	/* Raise the softirq only if required. */
-	if (time_before(jiffies, base->next_expiry)) {
-		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
-			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->next_expiry))
+	for (i = 0; i < NR_BASES; i++, base++) {
+		/*
+		 * The events of idle CPUs this CPU expires as a migrator are
+		 * checked along with the last base.
+		 */
+		if (time_after_eq(jiffies, base->next_expiry) ||
+		    (i == BASE_DEF && is_timers_nohz_active() &&
+		     tmigr_requires_handle_remote())) {
+			raise_softirq(TIMER_SOFTIRQ);
 			return;
+		}
 	}
-	raise_softirq(TIMER_SOFTIRQ);
 }
 
 /*
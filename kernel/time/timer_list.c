@@ -137,6 +137,7 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 	P(nr_hangs);
 	P(max_hang_time);
 #endif
+	P(nr_coalesced);
 #undef P
 #undef P_ns
 
@@ -256,7 +257,7 @@ static void timer_list_show_tickdevices_header(struct seq_file *m)
 
 static inline void timer_list_header(struct seq_file *m, u64 now)
 {
-	SEQ_printf(m, "Timer List Version: v0.9\n");
+	SEQ_printf(m, "Timer List Version: v0.10\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 	SEQ_printf(m, "\n");
@@ -0,0 +1,638 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Infrastructure for migratable timers
+ *
+ * Idle CPUs do not expire their global (non pinned) timers themselves. They
+ * hand the first of them over to a hierarchy of groups instead, and the
+ * active CPUs expire them on their behalf. This avoids waking idle CPUs for
+ * timers which do not care where they run, without pushing the timers to a
+ * busy CPU at enqueue time.
+ *
+ * The hierarchy is built at boot: up to TMIGR_CHILDREN_PER_GROUP CPUs of a
+ * NUMA node form a level 0 group, up to TMIGR_CHILDREN_PER_GROUP groups of
+ * a node form a group of the next level, until a node is covered by a
+ * single group. The node groups are then grouped the same way until a
+ * single top level group is left:
+ *
+ *	LVL 2			[GRP2:0]
+ *				 /      \
+ *	LVL 1		[GRP1:0]          [GRP1:1]
+ *			 /    \            /    \
+ *	LVL 0	  [GRP0:0]  [GRP0:1]  [GRP0:2]  [GRP0:3]
+ *	CPUS	    0-7       8-15      16-23     24-31
+ *
+ * A child of a group is either active or idle. A CPU is active while its
+ * tick runs, a group is active while one of its children is. One of the
+ * active children of a group is its migrator. The CPU which is the
+ * migrator of its level 0 group, of the parent of that group as far as the
+ * group is the migrator there, and so on, expires the events of the idle
+ * children of all these groups.
+ *
+ * An idle child has its first event queued in its group. The event of an
+ * idle group is the first event it has queued, and names the CPU owning
+ * it, so that a migrator expires the timers of that CPU directly, whatever
+ * the level of the event. The CPU event and the group events above it are
+ * then requeued with the next global timer of the CPU.
+ *
+ * When the last active CPU goes idle, the top level group becomes idle and
+ * the CPU has to wake up for the first event of the whole hierarchy. It then
+ * expires the events of all the groups which have no migrator.
+ *
+ * Locking: the timer base locks nest outside of tmigr_cpu::lock, which nests
+ * outside of the group locks. A group lock nests outside of the lock of its
+ * parent, and at most a child and its parent are locked at once: the state
+ * of a child is propagated into its parent one level at a time, each level
+ * reflecting the state of the child at the time it is locked.
+ */
+
+#include <linux/cpuhotplug.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <linux/nodemask.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/tick.h>
+#include <linux/timerqueue.h>
+#include <linux/workqueue.h>
+
+#include "timer_migration.h"
+#include "tick-internal.h"
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+
+static struct tmigr_event *tmigr_first_event(struct tmigr_group *group)
+{
+	struct timerqueue_node *node = timerqueue_getnext(&group->events);
+
+	return node ? container_of(node, struct tmigr_event, nextevt) : NULL;
+}
+
+static void tmigr_dequeue_event(struct tmigr_group *group,
+				struct tmigr_event *evt)
+{
+	if (timerqueue_node_queued(&evt->nextevt))
+		timerqueue_del(&group->events, &evt->nextevt);
+}
+
+static void tmigr_queue_event(struct tmigr_group *group,
+			      struct tmigr_event *evt, u64 expires,
+			      unsigned int cpu)
+{
+	tmigr_dequeue_event(group, evt);
+	evt->nextevt.expires = expires;
+	evt->cpu = cpu;
+	if (expires != KTIME_MAX)
+		timerqueue_add(&group->events, &evt->nextevt);
+}
+
+/*
+ * Reflect the state of a child into @group, whose lock is held: an active
+ * child is a migrator candidate and has no event queued, an idle child has
+ * its first event queued. Returns true when the parent of @group has to be
+ * updated as well, i.e. when @group switched between idle and active, or
+ * when the first event of the idle @group changed.
+ */
+static bool tmigr_set_child(struct tmigr_group *group, u8 childmask,
+			    bool active, struct tmigr_event *evt, u64 expires,
+			    unsigned int cpu)
+{
+	struct tmigr_event *first = tmigr_first_event(group);
+	unsigned int first_cpu = first ? first->cpu : UINT_MAX;
+	u64 first_expiry = group->next_expiry;
+	bool was_active = group->active;
+
+	if (active) {
+		group->active |= childmask;
+		if (group->migrator == TMIGR_NONE)
+			group->migrator = childmask;
+		tmigr_dequeue_event(group, evt);
+	} else {
+		group->active &= ~childmask;
+		if (group->migrator == childmask)
+			group->migrator = group->active ?
+					  BIT(__ffs(group->active)) : TMIGR_NONE;
+		tmigr_queue_event(group, evt, expires, cpu);
+	}
+
+	first = tmigr_first_event(group);
+	WRITE_ONCE(group->next_expiry, first ? first->nextevt.expires : KTIME_MAX);
+
+	if (!!group->active != was_active)
+		return true;
+
+	return !group->active && (group->next_expiry != first_expiry ||
+				  (first ? first->cpu : UINT_MAX) != first_cpu);
+}
+
+static bool tmigr_update_parent(struct tmigr_group *group)
+{
+	struct tmigr_group *parent = group->parent;
+	struct tmigr_event *first;
+	bool ret;
+
+	raw_spin_lock(&group->lock);
+	raw_spin_lock_nested(&parent->lock, SINGLE_DEPTH_NESTING);
+
+	first = tmigr_first_event(group);
+	ret = tmigr_set_child(parent, group->childmask, group->active,
+			      &group->groupevt, group->next_expiry,
+			      first ? first->cpu : 0);
+
+	raw_spin_unlock(&parent->lock);
+	raw_spin_unlock(&group->lock);
+
+	return ret;
+}
+
+/*
+ * Propagate the state of @tmc, with @nextexp as its first global timer,
+ * up the hierarchy as far as it makes a difference. Returns the first
+ * event of the hierarchy when this made the top level group idle or
+ * changed its first event while idle, KTIME_MAX otherwise.
+ */
+static u64 tmigr_walk(struct tmigr_cpu *tmc, u64 nextexp)
+{
+	struct tmigr_group *group = tmc->tmgroup;
+	bool changed;
+
+	lockdep_assert_held(&tmc->lock);
+
+	raw_spin_lock(&group->lock);
+	changed = tmigr_set_child(group, tmc->childmask, !tmc->idle,
+				  &tmc->cpuevt, nextexp, tmc->cpuevt.cpu);
+	raw_spin_unlock(&group->lock);
+
+	while (changed && group->parent) {
+		changed = tmigr_update_parent(group);
+		group = group->parent;
+	}
+
+	if (changed && !READ_ONCE(group->active))
+		return READ_ONCE(group->next_expiry);
+
+	return KTIME_MAX;
+}
+
+/**
+ * tmigr_cpu_activate() - set this CPU active in the timer migration hierarchy
+ *
+ * Called from the idle exit path with interrupts disabled, the CPU expires
+ * its global timers itself again.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (!tmc->online || !tmc->idle)
+		return;
+
+	raw_spin_lock(&tmc->lock);
+	tmc->idle = false;
+	WRITE_ONCE(tmc->wakeup, KTIME_MAX);
+	tmigr_walk(tmc, KTIME_MAX);
+	raw_spin_unlock(&tmc->lock);
+}
+
+/**
+ * tmigr_cpu_deactivate() - hand the global timers of this CPU over to the
+ *			    timer migration hierarchy
+ * @nextexp:	Expiry of the first global timer of the CPU, KTIME_MAX if none
+ *
+ * Called with interrupts disabled and the timer base locks of the CPU held
+ * when the CPU goes idle.
+ *
+ * Return: the first event of the hierarchy when this CPU was the last
+ * active one, KTIME_MAX otherwise. @nextexp when the CPU is not part of the
+ * hierarchy.
+ */
+u64 tmigr_cpu_deactivate(u64 nextexp)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	u64 ret;
+
+	if (!tmc->online)
+		return nextexp;
+
+	raw_spin_lock(&tmc->lock);
+	tmc->idle = true;
+	ret = tmigr_walk(tmc, nextexp);
+	WRITE_ONCE(tmc->wakeup, ret);
+	raw_spin_unlock(&tmc->lock);
+
+	return ret;
+}
+
+/**
+ * tmigr_cpu_new_timer() - update the event of this idle CPU
+ * @nextexp:	Expiry of the first global timer of the CPU, KTIME_MAX if none
+ *
+ * Called with interrupts disabled and the timer base locks of the CPU held,
+ * when the next event of an idle CPU is reevaluated, e.g. after a global
+ * timer was queued from an interrupt.
+ *
+ * Return: the first event of the hierarchy this CPU has to wake up for,
+ * KTIME_MAX if none. @nextexp when the CPU is not part of the hierarchy.
+ */
+u64 tmigr_cpu_new_timer(u64 nextexp)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	u64 ret;
+
+	if (!tmc->online)
+		return nextexp;
+
+	raw_spin_lock(&tmc->lock);
+	if (!WARN_ON_ONCE(!tmc->idle) &&
+	    nextexp != tmc->cpuevt.nextevt.expires) {
+		ret = tmigr_walk(tmc, nextexp);
+		if (ret != KTIME_MAX)
+			WRITE_ONCE(tmc->wakeup, ret);
+	}
+	ret = tmc->wakeup;
+	raw_spin_unlock(&tmc->lock);
+
+	return ret;
+}
+
+/**
+ * tmigr_quick_check() - predict the event this CPU would have to wake up
+ *			 for when going idle
+ * @nextexp:	Expiry of the first global timer of the CPU, KTIME_MAX if none
+ *
+ * Lockless check for the tick stop decision of an active CPU: unless the CPU
+ * is the only active one all the way up the hierarchy, another CPU takes
+ * care of the global timers once this one goes idle.
+ */
+u64 tmigr_quick_check(u64 nextexp)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	u8 childmask;
+
+	if (!tmc->online)
+		return nextexp;
+
+	if (WARN_ON_ONCE(tmc->idle))
+		return nextexp;
+
+	childmask = tmc->childmask;
+	for (group = tmc->tmgroup; group; group = group->parent) {
+		if (READ_ONCE(group->active) != childmask)
+			return KTIME_MAX;
+		nextexp = min_t(u64, nextexp, READ_ONCE(group->next_expiry));
+		childmask = group->childmask;
+	}
+
+	return nextexp;
+}
+
+/*
+ * Expire the global timers of the idle @cpu, then requeue its event with
+ * its next global timer. Returns false when there was nothing to do for
+ * this CPU.
+ */
+static bool tmigr_handle_remote_cpu(unsigned int cpu, u64 now,
+				    unsigned long jif)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	u64 nextexp;
+
+	raw_spin_lock_irq(&tmc->lock);
+	if (!tmc->online || !tmc->idle || tmc->remote ||
+	    tmc->cpuevt.nextevt.expires > now) {
+		raw_spin_unlock_irq(&tmc->lock);
+		return false;
+	}
+	tmc->remote = true;
+	/* Drop the lock to allow the remote CPU to exit idle */
+	raw_spin_unlock_irq(&tmc->lock);
+
+	/* The timers of this CPU were expired by run_timer_softirq() */
+	if (cpu != smp_processor_id())
+		timer_expire_remote(cpu);
+
+	/* The timer base locks nest outside of the timer migration ones */
+	local_irq_disable();
+	timer_lock_remote_bases(cpu);
+	raw_spin_lock(&tmc->lock);
+	nextexp = fetch_next_timer_interrupt_remote(jif, now, cpu);
+	timer_unlock_remote_bases(cpu);
+
+	/* When the CPU went out of idle meanwhile, it dequeued its event */
+	if (tmc->online && tmc->idle)
+		tmigr_walk(tmc, nextexp);
+
+	tmc->remote = false;
+	raw_spin_unlock_irq(&tmc->lock);
+
+	return true;
+}
+
+/**
+ * tmigr_handle_remote() - expire the expired events of the idle CPUs this
+ *			   CPU is responsible for
+ *
+ * Called from the timer softirq.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	u64 now, firstexp = KTIME_MAX;
+	unsigned long jif;
+	u8 childmask;
+
+	if (!tmc->online)
+		return;
+
+	now = get_jiffies_update(&jif);
+
+	childmask = tmc->childmask;
+	for (group = tmc->tmgroup; group; group = group->parent) {
+		raw_spin_lock_irq(&group->lock);
+
+		/* The group is handled by its own migrator */
+		if (group->migrator != childmask &&
+		    group->migrator != TMIGR_NONE) {
+			raw_spin_unlock_irq(&group->lock);
+			firstexp = KTIME_MAX;
+			break;
+		}
+
+		while (group->next_expiry <= now) {
+			unsigned int cpu = tmigr_first_event(group)->cpu;
+			bool handled;
+
+			raw_spin_unlock_irq(&group->lock);
+			handled = tmigr_handle_remote_cpu(cpu, now, jif);
+			raw_spin_lock_irq(&group->lock);
+
+			if (!handled)
+				break;
+		}
+
+		firstexp = group->next_expiry;
+		childmask = group->childmask;
+		raw_spin_unlock_irq(&group->lock);
+	}
+
+	/*
+	 * An idle CPU only runs this when it was the last one going idle. It
+	 * has to wake up again for the first event no migrator takes care of.
+	 */
+	raw_spin_lock_irq(&tmc->lock);
+	WRITE_ONCE(tmc->wakeup, tmc->idle ? firstexp : KTIME_MAX);
+	raw_spin_unlock_irq(&tmc->lock);
+}
+
+/**
+ * tmigr_requires_handle_remote() - check whether the timer softirq has to
+ *				    expire events of idle CPUs
+ *
+ * Lockless check from the tick of this CPU.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long jif;
+	u8 childmask;
+	u64 now;
+
+	if (!tmc->online)
+		return false;
+
+	now = get_jiffies_update(&jif);
+
+	if (tmc->idle)
+		return now >= READ_ONCE(tmc->wakeup);
+
+	childmask = tmc->childmask;
+	for (group = tmc->tmgroup;
+	     group && READ_ONCE(group->migrator) == childmask;
+	     group = group->parent) {
+		if (now >= READ_ONCE(group->next_expiry))
+			return true;
+		childmask = group->childmask;
+	}
+
+	return false;
+}
+
+/* Running on the CPU is enough, it left idle to do so */
+static long tmigr_trigger_active(void *unused)
+{
+	WARN_ON_ONCE(this_cpu_ptr(&tmigr_cpu)->idle);
+
+	return 0;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	/* nohz_full CPUs keep expiring their global timers themselves */
+	if (!tmc->tmgroup || tick_nohz_full_cpu(cpu))
+		return 0;
+
+	raw_spin_lock_irq(&tmc->lock);
+	tmc->idle = false;
+	WRITE_ONCE(tmc->wakeup, KTIME_MAX);
+	tmigr_walk(tmc, KTIME_MAX);
+	tmc->online = true;
+	raw_spin_unlock_irq(&tmc->lock);
+
+	return 0;
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	unsigned int migrator;
+	u64 firstexp;
+
+	if (!tmc->online)
+		return 0;
+
+	/*
+	 * The outgoing CPU leaves without event: timers_dead_cpu() moves its
+	 * global timers to a CPU which is still online.
+	 */
+	raw_spin_lock_irq(&tmc->lock);
+	tmc->idle = true;
+	firstexp = tmigr_walk(tmc, KTIME_MAX);
+	tmc->online = false;
+	WRITE_ONCE(tmc->wakeup, KTIME_MAX);
+	raw_spin_unlock_irq(&tmc->lock);
+
+	/*
+	 * This was the last active CPU: make sure that another CPU of the
+	 * hierarchy goes through idle and picks up the events.
+	 */
+	if (firstexp == KTIME_MAX)
+		return 0;
+
+	for_each_online_cpu(migrator) {
+		if (migrator != cpu && per_cpu(tmigr_cpu, migrator).online) {
+			work_on_cpu(migrator, tmigr_trigger_active, NULL);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static LIST_HEAD(tmigr_groups);
+
+static struct tmigr_group *tmigr_group_alloc(int node, unsigned int level)
+{
+	struct tmigr_group *group;
+
+	group = kzalloc_node(sizeof(*group), GFP_KERNEL, node);
+	if (!group)
+		return NULL;
+
+	raw_spin_lock_init(&group->lock);
+	timerqueue_init_head(&group->events);
+	timerqueue_init(&group->groupevt.nextevt);
+	group->next_expiry = KTIME_MAX;
+	group->migrator = TMIGR_NONE;
+	group->level = level;
+	group->numa_node = node;
+	list_add(&group->list, &tmigr_groups);
+
+	return group;
+}
+
+/*
+ * Group the @nr groups of @groups into parents at @level. The parents
+ * replace their children at the start of @groups. Returns the number of
+ * parents, -ENOMEM on allocation failure.
+ */
+static int __init tmigr_build_level(struct tmigr_group **groups, int nr,
+				    int node, unsigned int level)
+{
+	struct tmigr_group *parent = NULL;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		struct tmigr_group *child = groups[i];
+		unsigned int idx = i % TMIGR_CHILDREN_PER_GROUP;
+
+		if (!idx) {
+			parent = tmigr_group_alloc(node, level);
+			if (!parent)
+				return -ENOMEM;
+			groups[i / TMIGR_CHILDREN_PER_GROUP] = parent;
+		}
+		child->parent = parent;
+		child->childmask = BIT(idx);
+	}
+
+	return DIV_ROUND_UP(nr, TMIGR_CHILDREN_PER_GROUP);
+}
+
+/* Build the groups of @node, returns its top level group */
+static struct tmigr_group * __init tmigr_build_node(struct tmigr_group **groups,
+						    int node,
+						    unsigned int *level)
+{
+	unsigned int cpu;
+	int nr = 0;
+
+	for_each_possible_cpu(cpu) {
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+		unsigned int idx = nr % TMIGR_CHILDREN_PER_GROUP;
+
+		if (cpu_to_node(cpu) != node)
+			continue;
+
+		if (!idx) {
+			groups[nr / TMIGR_CHILDREN_PER_GROUP] =
+				tmigr_group_alloc(node, 0);
+			if (!groups[nr / TMIGR_CHILDREN_PER_GROUP])
+				return ERR_PTR(-ENOMEM);
+		}
+		tmc->tmgroup = groups[nr / TMIGR_CHILDREN_PER_GROUP];
+		tmc->childmask = BIT(idx);
+		nr++;
+	}
+
+	if (!nr)
+		return NULL;
+
+	nr = DIV_ROUND_UP(nr, TMIGR_CHILDREN_PER_GROUP);
+	for (*level = 0; nr > 1; ) {
+		nr = tmigr_build_level(groups, nr, node, ++(*level));
+		if (nr < 0)
+			return ERR_PTR(nr);
+	}
+
+	return groups[0];
+}
+
+static int __init tmigr_init(void)
+{
+	struct tmigr_group **groups, **tops, *group, *tmp;
+	unsigned int cpu, level, max_level = 0;
+	int node, nr_tops = 0, ret = -ENOMEM;
+
+	/* Nothing to gain on UP, the CPU expires its global timers itself */
+	if (num_possible_cpus() == 1)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+
+		raw_spin_lock_init(&tmc->lock);
+		timerqueue_init(&tmc->cpuevt.nextevt);
+		tmc->cpuevt.nextevt.expires = KTIME_MAX;
+		tmc->cpuevt.cpu = cpu;
+		tmc->wakeup = KTIME_MAX;
+	}
+
+	groups = kcalloc(nr_cpu_ids, sizeof(*groups), GFP_KERNEL);
+	tops = kcalloc(nr_node_ids, sizeof(*tops), GFP_KERNEL);
+	if (!groups || !tops)
+		goto err;
+
+	for_each_node(node) {
+		group = tmigr_build_node(groups, node, &level);
+		if (IS_ERR(group))
+			goto err;
+		if (!group)
+			continue;
+		tops[nr_tops++] = group;
+		max_level = max(max_level, level);
+	}
+
+	while (nr_tops > 1) {
+		nr_tops = tmigr_build_level(tops, nr_tops, NUMA_NO_NODE,
+					    ++max_level);
+		if (nr_tops < 0)
+			goto err;
+	}
+
+	ret = cpuhp_setup_state(CPUHP_AP_TMIGR_ONLINE, "tmigr:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	if (ret)
+		goto err;
+
+	pr_info("Timer migration: %u hierarchy levels; %d children per group\n",
+		max_level + 1, TMIGR_CHILDREN_PER_GROUP);
+	goto out;
+
+err:
+	for_each_possible_cpu(cpu)
+		per_cpu_ptr(&tmigr_cpu, cpu)->tmgroup = NULL;
+	list_for_each_entry_safe(group, tmp, &tmigr_groups, list)
+		kfree(group);
+	INIT_LIST_HEAD(&tmigr_groups);
+	pr_err("Timer migration setup failed\n");
+out:
+	kfree(tops);
+	kfree(groups);
+	return ret;
+}
+early_initcall(tmigr_init);
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef _KERNEL_TIME_MIGRATION_H
+#define _KERNEL_TIME_MIGRATION_H
+
+#include <linux/timerqueue.h>
+
+/* Per group capacity. Must be a power of 2! */
+#define TMIGR_CHILDREN_PER_GROUP	8
+
+/* Value of tmigr_group::migrator when no child is active */
+#define TMIGR_NONE			0xFF
+
+/**
+ * struct tmigr_event - a timer event associated to a CPU
+ * @nextevt:	The node to enqueue an event in the parent group queue
+ * @cpu:	The CPU to which this event belongs
+ */
+struct tmigr_event {
+	struct timerqueue_node	nextevt;
+	unsigned int		cpu;
+};
+
+/**
+ * struct tmigr_group - timer migration hierarchy group
+ * @lock:		Lock protecting the fields below and the events of
+ *			the children queued in @events
+ * @parent:		Pointer to the parent group, NULL for the top level
+ * @groupevt:		Next event of the group, queued in the parent group
+ *			while the group is idle. Its @cpu is the CPU owning
+ *			the first event of the group.
+ * @next_expiry:	Expiry of the first event of @events, KTIME_MAX if
+ *			there is none. Read locklessly.
+ * @events:		Timer queue of the first event of every idle child
+ * @active:		Bitmask of the active children
+ * @migrator:		childmask of the child expiring the events of the
+ *			idle children, or TMIGR_NONE when the group is idle
+ * @childmask:		Bit of the group in the parent group bitmasks
+ * @level:		Hierarchy level of the group (0 for the CPU groups)
+ * @numa_node:		NUMA node of the group, NUMA_NO_NODE above the node
+ *			levels
+ * @list:		Entry in the list of all groups
+ */
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;
+	struct tmigr_event	groupevt;
+	u64			next_expiry;
+	struct timerqueue_head	events;
+	u8			active;
+	u8			migrator;
+	u8			childmask;
+	u8			level;
+	int			numa_node;
+	struct list_head	list;
+};
+
+/**
+ * struct tmigr_cpu - timer migration per CPU state
+ * @lock:	Lock protecting the fields below and the CPU event
+ * @online:	Indicates whether the CPU takes part in the hierarchy
+ * @idle:	Indicates whether the CPU handed its global timers over to
+ *		the hierarchy
+ * @remote:	Set while another CPU expires the global timers of this CPU
+ * @childmask:	Bit of the CPU in the bitmasks of its group
+ * @tmgroup:	Level 0 group of the CPU
+ * @wakeup:	First event of the hierarchy this idle CPU has to wake up
+ *		for, KTIME_MAX if none. Read locklessly.
+ * @cpuevt:	First global timer of the CPU, queued in @tmgroup while the
+ *		CPU is idle
+ */
+struct tmigr_cpu {
+	raw_spinlock_t		lock;
+	bool			online;
+	bool			idle;
+	bool			remote;
+	u8			childmask;
+	struct tmigr_group	*tmgroup;
+	u64			wakeup;
+	struct tmigr_event	cpuevt;
+};
+
+#endif
@@ -15,12 +15,13 @@
  * Copyright (C) 2010		SUSE Linux Products GmbH
  * Copyright (C) 2010		Tejun Heo <tj@kernel.org>
  *
- * This is the generic async execution mechanism.  Work items as are
+ * This is the generic async execution mechanism.  Work items are
  * executed in process context.  The worker pool is shared and
  * automatically managed.  There are two worker pools for each CPU (one for
  * normal work items and the other for high priority ones) and some extra
  * pools for workqueues which are not bound to any specific CPU - the
- * number of these backing pools is dynamic.
+ * number of these backing pools is dynamic.  Work items of BH workqueues
+ * are executed in softirq context by two more per-CPU pools.
  *
  * Please read Documentation/core-api/workqueue.rst for details.
  */
@@ -53,6 +54,9 @@
 #include <linux/nmi.h>
 #include <linux/kvm_para.h>
 #include <linux/delay.h>
+#include <linux/irq_work.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_internal.h"
 
@@ -72,9 +76,13 @@ enum {
 	 * Note that DISASSOCIATED should be flipped only while holding
 	 * wq_pool_attach_mutex to avoid changing binding state while
 	 * worker_attach_to_pool() is in progress.
+	 *
+	 * A BH pool is per-CPU and always DISASSOCIATED.
 	 */
 	POOL_MANAGER_ACTIVE	= 1 << 0,	/* being managed */
+	POOL_BH			= 1 << 1,	/* is a BH pool */
 	POOL_DISASSOCIATED	= 1 << 2,	/* cpu can't serve workers */
+	POOL_BH_DRAINING	= 1 << 3,	/* draining after CPU offline */
 
 	/* worker flags */
 	WORKER_DIE		= 1 << 1,	/* die die die */
@@ -101,6 +109,17 @@ enum {
 	MAYDAY_INTERVAL		= HZ / 10,	/* and then every 100ms */
 	CREATE_COOLDOWN		= HZ,		/* time to breath after fail */
 
+	/*
+	 * A BH worker returns from softirq once it has been running for
+	 * BH_WORKER_JIFFIES or has restarted BH_WORKER_RESTARTS times and
+	 * raises the softirq again if work items are left, so that a busy BH
+	 * pool can't starve the other softirqs and the tasks on the CPU.
+	 */
+	BH_WORKER_JIFFIES	= msecs_to_jiffies(2),
+	BH_WORKER_RESTARTS	= 10,
+
+	WQ_HIST_NR_BUCKETS	= 24,		/* log2 usecs, up to ~4s */
+
 	/*
 	 * Rescue workers are used only on emergencies and shared by
 	 * all cpus.  Give MIN_NICE.
@@ -145,6 +164,8 @@ enum {
  *
  * MD: wq_mayday_lock protected.
  *
+ * H: wq->hist_lock protected.
+ *
  * WD: Used internally by the watchdog.
  */
 
@@ -257,6 +278,12 @@ struct pool_workqueue {
 
 	u64			stats[PWQ_NR_STATS];
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+	/* see wq_hist_add() */
+	u64			lat_hist[WQ_HIST_NR_BUCKETS]; /* L: queueing */
+	u64			run_hist[WQ_HIST_NR_BUCKETS]; /* L: execution */
+#endif
+
 	/*
 	 * Release of unbound pwq is punted to a kthread_worker. See put_pwq()
 	 * and pwq_release_workfn() for details. pool_workqueue itself is also
@@ -306,6 +333,12 @@ struct workqueue_struct {
 #ifdef CONFIG_SYSFS
 	struct wq_device	*wq_dev;	/* I: for sysfs interface */
 #endif
+#ifdef CONFIG_WQ_LATENCY_HIST
+	/* histograms of the pwqs released so far, see wq_unlink_pwq() */
+	raw_spinlock_t		hist_lock;
+	u64			lat_hist[WQ_HIST_NR_BUCKETS]; /* H: queueing */
+	u64			run_hist[WQ_HIST_NR_BUCKETS]; /* H: execution */
+#endif
 #ifdef CONFIG_LOCKDEP
 	char			*lock_name;
 	struct lock_class_key	key;
@@ -405,8 +438,17 @@ static bool wq_debug_force_rr_cpu = false;
 #endif
 module_param_named(debug_force_rr_cpu, wq_debug_force_rr_cpu, bool, 0644);
 
+/* the BH worker pools */
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct worker_pool [NR_STD_WORKER_POOLS],
+				     bh_worker_pools);
+
 /* the per-cpu worker pools */
-static DEFINE_PER_CPU_SHARED_ALIGNED(struct worker_pool [NR_STD_WORKER_POOLS], cpu_worker_pools);
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct worker_pool [NR_STD_WORKER_POOLS],
+				     cpu_worker_pools);
+
+/* kick the BH pools of a remote CPU */
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct irq_work [NR_STD_WORKER_POOLS],
+				     bh_pool_irq_works);
 
 static DEFINE_IDR(worker_pool_idr);	/* PR: idr of all pools */
 
@@ -440,6 +482,10 @@ struct workqueue_struct *system_power_efficient_wq __ro_after_init;
 EXPORT_SYMBOL_GPL(system_power_efficient_wq);
 struct workqueue_struct *system_freezable_power_efficient_wq __ro_after_init;
 EXPORT_SYMBOL_GPL(system_freezable_power_efficient_wq);
+struct workqueue_struct *system_bh_wq __ro_after_init;
+EXPORT_SYMBOL_GPL(system_bh_wq);
+struct workqueue_struct *system_bh_highpri_wq __ro_after_init;
+EXPORT_SYMBOL_GPL(system_bh_highpri_wq);
 
 static int worker_thread(void *__worker);
 static void workqueue_sysfs_unregister(struct workqueue_struct *wq);
@@ -460,6 +506,11 @@ static void show_one_worker_pool(struct worker_pool *pool);
 			 !lockdep_is_held(&wq_pool_mutex),		\
 			 "RCU, wq->mutex or wq_pool_mutex should be held")
 
+#define for_each_bh_worker_pool(pool, cpu)				\
+	for ((pool) = &per_cpu(bh_worker_pools, cpu)[0];		\
+	     (pool) < &per_cpu(bh_worker_pools, cpu)[NR_STD_WORKER_POOLS]; \
+	     (pool)++)
+
 #define for_each_cpu_worker_pool(pool, cpu)				\
 	for ((pool) = &per_cpu(cpu_worker_pools, cpu)[0];		\
 	     (pool) < &per_cpu(cpu_worker_pools, cpu)[NR_STD_WORKER_POOLS]; \
@@ -1101,6 +1152,29 @@ static bool assign_work(struct work_struct *work, struct worker *worker,
 	return true;
 }
 
+static struct irq_work *bh_pool_irq_work(struct worker_pool *pool)
+{
+	int high = pool->attrs->nice == HIGHPRI_NICE_LEVEL ? 1 : 0;
+
+	return &per_cpu(bh_pool_irq_works, pool->cpu)[high];
+}
+
+static void kick_bh_pool(struct worker_pool *pool)
+{
+#ifdef CONFIG_SMP
+	/* see drain_dead_softirq_workfn() for BH_DRAINING */
+	if (unlikely(pool->cpu != smp_processor_id() &&
+		     !(pool->flags & POOL_BH_DRAINING))) {
+		irq_work_queue_on(bh_pool_irq_work(pool), pool->cpu);
+		return;
+	}
+#endif
+	if (pool->attrs->nice == HIGHPRI_NICE_LEVEL)
+		raise_softirq_irqoff(HI_SOFTIRQ);
+	else
+		raise_softirq_irqoff(TASKLET_SOFTIRQ);
+}
+
 /**
  * kick_pool - wake up an idle worker if necessary
  * @pool: pool to kick
@@ -1118,6 +1192,11 @@ static bool kick_pool(struct worker_pool *pool)
 	if (!need_more_worker(pool) || !worker)
 		return false;
 
+	if (pool->flags & POOL_BH) {
+		kick_bh_pool(pool);
+		return true;
+	}
+
 	p = worker->task;
 
 #ifdef CONFIG_SMP
@@ -1631,6 +1710,73 @@ static int try_to_grab_pending(struct work_struct *work, bool is_dwork,
 	return -EAGAIN;
 }
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+/*
+ * Histograms of the time work items spend queued and executing. Bucket 0
+ * counts durations below 1us, bucket i > 0 those in [2^(i-1), 2^i) usecs and
+ * the last bucket everything longer. local_clock() isn't synchronized across
+ * CPUs, a negative duration of a work item executed on another CPU than the
+ * one it was queued on is counted as 0.
+ */
+static void wq_hist_add(u64 *hist, u64 from, u64 to)
+{
+	u64 us = to > from ? div_u64(to - from, NSEC_PER_USEC) : 0;
+	int bucket = us ? min_t(int, ilog2(us) + 1, WQ_HIST_NR_BUCKETS - 1) : 0;
+
+	hist[bucket]++;
+}
+
+static void wq_hist_sum(struct workqueue_struct *wq, bool runtime, u64 *hist)
+{
+	struct pool_workqueue *pwq;
+	int i;
+
+	rcu_read_lock();
+	raw_spin_lock(&wq->hist_lock);
+	memcpy(hist, runtime ? wq->run_hist : wq->lat_hist,
+	       sizeof(u64) * WQ_HIST_NR_BUCKETS);
+	for_each_pwq(pwq, wq) {
+		u64 *pwq_hist = runtime ? pwq->run_hist : pwq->lat_hist;
+
+		for (i = 0; i < WQ_HIST_NR_BUCKETS; i++)
+			hist[i] += READ_ONCE(pwq_hist[i]);
+	}
+	raw_spin_unlock(&wq->hist_lock);
+	rcu_read_unlock();
+}
+
+/*
+ * Unbound pwqs are replaced when the attributes of their wq change: fold
+ * the histograms of a released pwq into its wq, at once with unlinking it
+ * for wq_hist_sum(). Its work items are all done.
+ */
+static void wq_unlink_pwq(struct workqueue_struct *wq,
+			  struct pool_workqueue *pwq)
+{
+	int i;
+
+	raw_spin_lock(&wq->hist_lock);
+	for (i = 0; i < WQ_HIST_NR_BUCKETS; i++) {
+		wq->lat_hist[i] += pwq->lat_hist[i];
+		wq->run_hist[i] += pwq->run_hist[i];
+	}
+	list_del_rcu(&pwq->pwqs_node);
+	raw_spin_unlock(&wq->hist_lock);
+}
+
+/* lower bound of @bucket in usecs */
+static u64 wq_hist_bucket_us(int bucket)
+{
+	return bucket ? 1ULL << (bucket - 1) : 0;
+}
+#else
+static void wq_unlink_pwq(struct workqueue_struct *wq,
+			  struct pool_workqueue *pwq)
+{
+	list_del_rcu(&pwq->pwqs_node);
+}
+#endif
+
 /**
  * insert_work - insert a work into a pool
  * @pwq: pwq @work belongs to
@@ -1649,6 +1795,10 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 {
 	debug_work_activate(work);
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+	work->queued_at = local_clock();
+#endif
+
 	/* record the work call stack in order to print it in KASAN reports */
 	kasan_record_aux_stack_noalloc(work);
 
@@ -2187,27 +2337,30 @@ static struct worker *create_worker(struct worker_pool *pool)
 
 	worker->id = id;
 
-	if (pool->cpu >= 0)
-		snprintf(id_buf, sizeof(id_buf), "%d:%d%s", pool->cpu, id,
-			 pool->attrs->nice < 0  ? "H" : "");
-	else
-		snprintf(id_buf, sizeof(id_buf), "u%d:%d", pool->id, id);
-
-	worker->task = kthread_create_on_node(worker_thread, worker, pool->node,
-					      "kworker/%s", id_buf);
-	if (IS_ERR(worker->task)) {
-		if (PTR_ERR(worker->task) == -EINTR) {
-			pr_err("workqueue: Interrupted when creating a worker thread \"kworker/%s\"\n",
-			       id_buf);
-		} else {
-			pr_err_once("workqueue: Failed to create a worker thread: %pe",
-				    worker->task);
+	/* BH workers run from softirq and don't have a kthread */
+	if (!(pool->flags & POOL_BH)) {
+		if (pool->cpu >= 0)
+			snprintf(id_buf, sizeof(id_buf), "%d:%d%s", pool->cpu, id,
+				 pool->attrs->nice < 0  ? "H" : "");
+		else
+			snprintf(id_buf, sizeof(id_buf), "u%d:%d", pool->id, id);
+
+		worker->task = kthread_create_on_node(worker_thread, worker,
+						      pool->node, "kworker/%s", id_buf);
+		if (IS_ERR(worker->task)) {
+			if (PTR_ERR(worker->task) == -EINTR) {
+				pr_err("workqueue: Interrupted when creating a worker thread \"kworker/%s\"\n",
+				       id_buf);
+			} else {
+				pr_err_once("workqueue: Failed to create a worker thread: %pe",
+					    worker->task);
+			}
+			goto fail;
 		}
-		goto fail;
-	}
 
-	set_user_nice(worker->task, pool->attrs->nice);
-	kthread_bind_mask(worker->task, pool_allowed_cpus(pool));
+		set_user_nice(worker->task, pool->attrs->nice);
+		kthread_bind_mask(worker->task, pool_allowed_cpus(pool));
+	}
 
 	/* successful, attach the worker to the pool */
 	worker_attach_to_pool(worker, pool);
@@ -2224,7 +2377,8 @@ static struct worker *create_worker(struct worker_pool *pool)
 	 * check if not woken up soon. As kick_pool() might not have waken it
 	 * up, wake it up explicitly once more.
 	 */
-	wake_up_process(worker->task);
+	if (worker->task)
+		wake_up_process(worker->task);
 
 	raw_spin_unlock_irq(&pool->lock);
 
@@ -2543,6 +2697,11 @@ __acquires(&pool->lock)
 	struct pool_workqueue *pwq = get_work_pwq(work);
 	struct worker_pool *pool = worker->pool;
 	unsigned long work_data;
+	int lockdep_start_depth;
+	bool bh_draining;
+#ifdef CONFIG_WQ_LATENCY_HIST
+	u64 queued_at, started_at, finished_at;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2565,7 +2724,8 @@ __acquires(&pool->lock)
 	worker->current_work = work;
 	worker->current_func = work->func;
 	worker->current_pwq = pwq;
-	worker->current_at = worker->task->se.sum_exec_runtime;
+	if (worker->task)
+		worker->current_at = worker->task->se.sum_exec_runtime;
 	work_data = *work_data_bits(work);
 	worker->current_color = get_work_color(work_data);
 
@@ -2594,6 +2754,11 @@ __acquires(&pool->lock)
 	 */
 	kick_pool(pool);
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+	/* @work may be queued again, and restamped, once PENDING is clear */
+	queued_at = work->queued_at;
+#endif
+
 	/*
 	 * Record the last pool and clear PENDING which should be the last
 	 * update to @work.  Also, do this inside @pool->lock so that
@@ -2603,9 +2768,22 @@ __acquires(&pool->lock)
 	set_work_pool_and_clear_pending(work, pool->id);
 
 	pwq->stats[PWQ_STAT_STARTED]++;
+#ifdef CONFIG_WQ_LATENCY_HIST
+	started_at = local_clock();
+	wq_hist_add(pwq->lat_hist, queued_at, started_at);
+#endif
+	bh_draining = pool->flags & POOL_BH_DRAINING;
 	raw_spin_unlock_irq(&pool->lock);
 
-	lock_map_acquire(&pwq->wq->lockdep_map);
+	/*
+	 * A BH worker may run on top of a task holding locks, and the work
+	 * items of a dead CPU's BH pool are executed from a BH work item, see
+	 * drain_dead_softirq_workfn(). Only look at what @work itself leaves
+	 * behind and don't nest the BH workqueue's lockdep_map.
+	 */
+	lockdep_start_depth = lockdep_depth(current);
+	if (!bh_draining)
+		lock_map_acquire(&pwq->wq->lockdep_map);
 	lock_map_acquire(&lockdep_map);
 	/*
 	 * Strictly speaking we should mark the invariant state without holding
@@ -2631,6 +2809,9 @@ __acquires(&pool->lock)
 	lockdep_invariant_state(true);
 	trace_workqueue_execute_start(work);
 	worker->current_func(work);
+#ifdef CONFIG_WQ_LATENCY_HIST
+	finished_at = local_clock();
+#endif
 	/*
 	 * While we must be careful to not use "work" after this, the trace
 	 * point will only record its address.
@@ -2638,9 +2819,11 @@ __acquires(&pool->lock)
 	trace_workqueue_execute_end(work, worker->current_func);
 	pwq->stats[PWQ_STAT_COMPLETED]++;
 	lock_map_release(&lockdep_map);
-	lock_map_release(&pwq->wq->lockdep_map);
+	if (!bh_draining)
+		lock_map_release(&pwq->wq->lockdep_map);
 
-	if (unlikely(in_atomic() || lockdep_depth(current) > 0)) {
+	if (unlikely((worker->task && in_atomic()) ||
+		     lockdep_depth(current) != lockdep_start_depth)) {
 		pr_err("BUG: workqueue leaked lock or atomic: %s/0x%08x/%d\n"
 		       "     last function: %ps\n",
 		       current->comm, preempt_count(), task_pid_nr(current),
@@ -2655,12 +2838,17 @@ __acquires(&pool->lock)
 	 * happen could deadlock with stop_machine as such work item could
 	 * indefinitely requeue itself while all other CPUs are trapped in
 	 * stop_machine. At the same time, report a quiescent RCU state so
-	 * the same condition doesn't freeze RCU.
+	 * the same condition doesn't freeze RCU. BH workers can't sleep.
 	 */
-	cond_resched();
+	if (worker->task)
+		cond_resched();
 
 	raw_spin_lock_irq(&pool->lock);
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+	wq_hist_add(pwq->run_hist, started_at, finished_at);
+#endif
+
 	/*
 	 * In addition to %WQ_CPU_INTENSIVE, @worker may also have been marked
 	 * CPU intensive by wq_worker_tick() if @work hogged CPU longer than
@@ -2938,6 +3126,146 @@ static int rescuer_thread(void *__rescuer)
 	goto repeat;
 }
 
+/*
+ * bh_worker - execute the work items of a BH pool from softirq context
+ * @worker: the single worker of the BH pool
+ *
+ * Like worker_thread() but bounded by BH_WORKER_RESTARTS and
+ * BH_WORKER_JIFFIES. kick_pool() raises the softirq again if work items are
+ * left once the budget is spent.
+ */
+static void bh_worker(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+	int nr_restarts = BH_WORKER_RESTARTS;
+	unsigned long end = jiffies + BH_WORKER_JIFFIES;
+
+	raw_spin_lock_irq(&pool->lock);
+	worker_leave_idle(worker);
+
+	/*
+	 * This function follows the structure of worker_thread(). See there for
+	 * explanations on each step.
+	 */
+	if (!need_more_worker(pool))
+		goto done;
+
+	WARN_ON_ONCE(!list_empty(&worker->scheduled));
+	worker_clr_flags(worker, WORKER_PREP | WORKER_REBOUND);
+
+	do {
+		struct work_struct *work =
+			list_first_entry(&pool->worklist,
+					 struct work_struct, entry);
+
+		if (assign_work(work, worker, NULL))
+			process_scheduled_works(worker);
+	} while (keep_working(pool) &&
+		 --nr_restarts && time_before(jiffies, end));
+
+	worker_set_flags(worker, WORKER_PREP);
+done:
+	worker_enter_idle(worker);
+	kick_pool(pool);
+	raw_spin_unlock_irq(&pool->lock);
+}
+
+/**
+ * workqueue_softirq_action - run the BH work items of the local CPU
+ * @highpri: run the high priority BH pool
+ *
+ * BH pools share TASKLET_SOFTIRQ and HI_SOFTIRQ with the tasklets, so this is
+ * called from tasklet[_hi]_action() whenever either has something to run.
+ * Return early if the BH pool has nothing queued.
+ */
+void workqueue_softirq_action(bool highpri)
+{
+	struct worker_pool *pool =
+		&per_cpu(bh_worker_pools, smp_processor_id())[highpri];
+
+	if (need_more_worker(pool))
+		bh_worker(list_first_entry(&pool->workers, struct worker, node));
+}
+
+struct wq_drain_dead_softirq_work {
+	struct work_struct	work;
+	struct worker_pool	*pool;
+	struct completion	done;
+};
+
+static void drain_dead_softirq_workfn(struct work_struct *work)
+{
+	struct wq_drain_dead_softirq_work *dead_work =
+		container_of(work, struct wq_drain_dead_softirq_work, work);
+	struct worker_pool *pool = dead_work->pool;
+	bool repeat;
+
+	/*
+	 * @pool's CPU is dead and we want to execute its still pending work
+	 * items from this BH work item which is running on a different CPU. As
+	 * its CPU is dead, @pool can't be kicked and, as work execution path
+	 * will be nested, a lockdep annotation needs to be suppressed. Mark
+	 * @pool with %POOL_BH_DRAINING for the special treatments.
+	 */
+	raw_spin_lock_irq(&pool->lock);
+	pool->flags |= POOL_BH_DRAINING;
+	raw_spin_unlock_irq(&pool->lock);
+
+	bh_worker(list_first_entry(&pool->workers, struct worker, node));
+
+	raw_spin_lock_irq(&pool->lock);
+	pool->flags &= ~POOL_BH_DRAINING;
+	repeat = need_more_worker(pool);
+	raw_spin_unlock_irq(&pool->lock);
+
+	/*
+	 * bh_worker() might hit consecutive execution limit and bail. If there
+	 * still are pending work items, reschedule self and return so that we
+	 * don't hog this CPU's BH.
+	 */
+	if (repeat) {
+		if (pool->attrs->nice == HIGHPRI_NICE_LEVEL)
+			queue_work(system_bh_highpri_wq, work);
+		else
+			queue_work(system_bh_wq, work);
+	} else {
+		complete(&dead_work->done);
+	}
+}
+
+/*
+ * @cpu is dead. Drain the remaining BH work items on the current CPU. It's
+ * possible to allocate dead_work per CPU and avoid flushing. However, then we
+ * have to worry about draining overlapping with CPU coming back online or
+ * nesting (one CPU's dead_work queued on another CPU which is also dead and so
+ * on). Let's keep it simple and drain them synchronously. These are BH work
+ * items which shouldn't be requeued on the same pool. Shouldn't take long.
+ */
+void workqueue_softirq_dead(unsigned int cpu)
+{
+	int i;
+
+	for (i = 0; i < NR_STD_WORKER_POOLS; i++) {
+		struct worker_pool *pool = &per_cpu(bh_worker_pools, cpu)[i];
+		struct wq_drain_dead_softirq_work dead_work;
+
+		if (!need_more_worker(pool))
+			continue;
+
+		INIT_WORK_ONSTACK(&dead_work.work, drain_dead_softirq_workfn);
+		dead_work.pool = pool;
+		init_completion(&dead_work.done);
+
+		if (pool->attrs->nice == HIGHPRI_NICE_LEVEL)
+			queue_work(system_bh_highpri_wq, &dead_work.work);
+		else
+			queue_work(system_bh_wq, &dead_work.work);
+
+		wait_for_completion(&dead_work.done);
+		destroy_work_on_stack(&dead_work.work);
+	}
+}
+
 /**
  * check_flush_dependency - check for flush dependency sanity
  * @target_wq: workqueue being flushed
@@ -4119,7 +4447,7 @@ static void pwq_release_workfn(struct kthread_work *work)
 	 */
 	if (!list_empty(&pwq->pwqs_node)) {
 		mutex_lock(&wq->mutex);
-		list_del_rcu(&pwq->pwqs_node);
+		wq_unlink_pwq(wq, pwq);
 		is_last = list_empty(&wq->pwqs);
 		mutex_unlock(&wq->mutex);
 	}
@@ -4558,11 +4886,18 @@ static int alloc_and_link_pwqs(struct workqueue_struct *wq)
 		goto enomem;
 
 	if (!(wq->flags & WQ_UNBOUND)) {
+		struct worker_pool __percpu *pools;
+
+		if (wq->flags & WQ_BH)
+			pools = bh_worker_pools;
+		else
+			pools = cpu_worker_pools;
+
 		for_each_possible_cpu(cpu) {
 			struct pool_workqueue **pwq_p =
 				per_cpu_ptr(wq->cpu_pwq, cpu);
 			struct worker_pool *pool =
-				&(per_cpu_ptr(cpu_worker_pools, cpu)[highpri]);
+				&(per_cpu_ptr(pools, cpu)[highpri]);
 
 			*pwq_p = kmem_cache_alloc_node(pwq_cache, GFP_KERNEL,
 						       pool->node);
@@ -4667,6 +5002,13 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 	struct workqueue_struct *wq;
 	struct pool_workqueue *pwq;
 
+	if (flags & WQ_BH) {
+		if (WARN_ON_ONCE(flags & ~__WQ_BH_ALLOWS))
+			return NULL;
+		if (WARN_ON_ONCE(max_active))
+			return NULL;
+	}
+
 	/*
 	 * Unbound && max_active == 1 used to imply ordered, which is no longer
 	 * the case on many machines due to per-pod pools. While
@@ -4695,13 +5037,24 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 	vsnprintf(wq->name, sizeof(wq->name), fmt, args);
 	va_end(args);
 
-	max_active = max_active ?: WQ_DFL_ACTIVE;
-	max_active = wq_clamp_max_active(max_active, flags, wq->name);
+	if (flags & WQ_BH) {
+		/*
+		 * BH workqueues always share a single execution context per CPU
+		 * and don't impose any max_active limit.
+		 */
+		max_active = INT_MAX;
+	} else {
+		max_active = max_active ?: WQ_DFL_ACTIVE;
+		max_active = wq_clamp_max_active(max_active, flags, wq->name);
+	}
 
 	/* init wq */
 	wq->flags = flags;
 	wq->saved_max_active = max_active;
 	mutex_init(&wq->mutex);
+#ifdef CONFIG_WQ_LATENCY_HIST
+	raw_spin_lock_init(&wq->hist_lock);
+#endif
 	atomic_set(&wq->nr_pwqs_to_flush, 0);
 	INIT_LIST_HEAD(&wq->pwqs);
 	INIT_LIST_HEAD(&wq->flusher_queue);
@@ -4869,6 +5222,9 @@ void workqueue_set_max_active(struct workqueue_struct *wq, int max_active)
 {
 	struct pool_workqueue *pwq;
 
+	/* max_active doesn't mean anything for BH workqueues */
+	if (WARN_ON(wq->flags & WQ_BH))
+		return;
 	/* disallow meddling with max_active for ordered workqueues */
 	if (WARN_ON(wq->flags & __WQ_ORDERED_EXPLICIT))
 		return;
@@ -5069,7 +5425,24 @@ static void pr_cont_pool_info(struct worker_pool *pool)
 	pr_cont(" cpus=%*pbl", nr_cpumask_bits, pool->attrs->cpumask);
 	if (pool->node != NUMA_NO_NODE)
 		pr_cont(" node=%d", pool->node);
-	pr_cont(" flags=0x%x nice=%d", pool->flags, pool->attrs->nice);
+	pr_cont(" flags=0x%x", pool->flags);
+	if (pool->flags & POOL_BH)
+		pr_cont(" bh%s",
+			pool->attrs->nice == HIGHPRI_NICE_LEVEL ? "-hi" : "");
+	else
+		pr_cont(" nice=%d", pool->attrs->nice);
+}
+
+static void pr_cont_worker_id(struct worker *worker)
+{
+	struct worker_pool *pool = worker->pool;
+
+	if (pool->flags & POOL_BH)
+		pr_cont("bh%s",
+			pool->attrs->nice == HIGHPRI_NICE_LEVEL ? "-hi" : "");
+	else
+		pr_cont("%d%s", task_pid_nr(worker->task),
+			worker->rescue_wq ? "(RESCUER)" : "");
 }
 
 struct pr_cont_work_struct {
@@ -5146,10 +5519,9 @@ static void show_pwq(struct pool_workqueue *pwq)
 			if (worker->current_pwq != pwq)
 				continue;
 
-			pr_cont("%s %d%s:%ps", comma ? "," : "",
-				task_pid_nr(worker->task),
-				worker->rescue_wq ? "(RESCUER)" : "",
-				worker->current_func);
+			pr_cont("%s ", comma ? "," : "");
+			pr_cont_worker_id(worker);
+			pr_cont(":%ps", worker->current_func);
 			list_for_each_entry(work, &worker->scheduled, entry)
 				pr_cont_work(false, work, &pcws);
 			pr_cont_work_flush(comma, (work_func_t)-1L, &pcws);
@@ -5268,8 +5640,8 @@ static void show_one_worker_pool(struct worker_pool *pool)
 		pr_cont(" manager: %d",
 			task_pid_nr(pool->manager->task));
 	list_for_each_entry(worker, &pool->idle_list, entry) {
-		pr_cont(" %s%d", first ? "idle: " : "",
-			task_pid_nr(worker->task));
+		pr_cont(" %s", first ? "idle: " : "");
+		pr_cont_worker_id(worker);
 		first = false;
 	}
 	pr_cont("\n");
@@ -5914,6 +6286,8 @@ module_param_cb(default_affinity_scope, &wq_affn_dfl_ops, NULL, 0644);
  *
  *  per_cpu		RO bool	: whether the workqueue is per-cpu or unbound
  *  max_active		RW int	: maximum number of in-flight work items
+ *  latency_hist	RO hist	: queueing latency, with WQ_LATENCY_HIST
+ *  runtime_hist	RO hist	: execution time, with WQ_LATENCY_HIST
  *
  * Unbound workqueues have the following extra attributes.
  *
@@ -5966,9 +6340,44 @@ static ssize_t max_active_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(max_active);
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+/* one line per bucket: lower bound in usecs and number of work items */
+static ssize_t wq_hist_show(struct workqueue_struct *wq, bool runtime,
+			    char *buf)
+{
+	u64 hist[WQ_HIST_NR_BUCKETS];
+	int i, written = 0;
+
+	wq_hist_sum(wq, runtime, hist);
+	for (i = 0; i < WQ_HIST_NR_BUCKETS; i++)
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     "%llu %llu\n", wq_hist_bucket_us(i), hist[i]);
+
+	return written;
+}
+
+static ssize_t latency_hist_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	return wq_hist_show(dev_to_wq(dev), false, buf);
+}
+static DEVICE_ATTR_RO(latency_hist);
+
+static ssize_t runtime_hist_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	return wq_hist_show(dev_to_wq(dev), true, buf);
+}
+static DEVICE_ATTR_RO(runtime_hist);
+#endif
+
 static struct attribute *wq_sysfs_attrs[] = {
 	&dev_attr_per_cpu.attr,
 	&dev_attr_max_active.attr,
+#ifdef CONFIG_WQ_LATENCY_HIST
+	&dev_attr_latency_hist.attr,
+	&dev_attr_runtime_hist.attr,
+#endif
 	NULL,
 };
 ATTRIBUTE_GROUPS(wq_sysfs);
@@ -6374,6 +6783,66 @@ static void workqueue_sysfs_unregister(struct workqueue_struct *wq)
 static void workqueue_sysfs_unregister(struct workqueue_struct *wq)	{ }
 #endif	/* CONFIG_SYSFS */
 
+#if defined(CONFIG_WQ_LATENCY_HIST) && defined(CONFIG_DEBUG_FS)
+/*
+ * workqueue/{latency,runtime}_hist in debugfs show the histograms of all
+ * workqueues which have executed work items, one workqueue per line after a
+ * header line with the lower bounds of the buckets in usecs.
+ */
+static int wq_debugfs_hist_show(struct seq_file *m, bool runtime)
+{
+	struct workqueue_struct *wq;
+	u64 hist[WQ_HIST_NR_BUCKETS];
+	int i;
+
+	seq_puts(m, "# workqueue");
+	for (i = 0; i < WQ_HIST_NR_BUCKETS; i++)
+		seq_printf(m, " %llu", wq_hist_bucket_us(i));
+	seq_putc(m, '\n');
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(wq, &workqueues, list) {
+		bool empty = true;
+
+		wq_hist_sum(wq, runtime, hist);
+		for (i = 0; i < WQ_HIST_NR_BUCKETS; i++)
+			empty &= !hist[i];
+		if (empty)
+			continue;
+
+		seq_puts(m, wq->name);
+		for (i = 0; i < WQ_HIST_NR_BUCKETS; i++)
+			seq_printf(m, " %llu", hist[i]);
+		seq_putc(m, '\n');
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int wq_latency_hist_show(struct seq_file *m, void *v)
+{
+	return wq_debugfs_hist_show(m, false);
+}
+DEFINE_SHOW_ATTRIBUTE(wq_latency_hist);
+
+static int wq_runtime_hist_show(struct seq_file *m, void *v)
+{
+	return wq_debugfs_hist_show(m, true);
+}
+DEFINE_SHOW_ATTRIBUTE(wq_runtime_hist);
+
+static int __init wq_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("workqueue", NULL);
+
+	debugfs_create_file("latency_hist", 0444, dir, NULL, &wq_latency_hist_fops);
+	debugfs_create_file("runtime_hist", 0444, dir, NULL, &wq_runtime_hist_fops);
+	return 0;
+}
+late_initcall(wq_debugfs_init);
+#endif
+
 /*
  * Workqueue watchdog.
  *
@@ -6414,7 +6883,8 @@ static void show_cpu_pool_hog(struct worker_pool *pool)
 	raw_spin_lock_irqsave(&pool->lock, flags);
 
 	hash_for_each(pool->busy_hash, bkt, worker, hentry) {
-		if (task_is_running(worker->task)) {
+		/* a stalled BH pool shows up in the backtrace of its CPU */
+		if (worker->task && task_is_running(worker->task)) {
 			/*
 			 * Defer printing to avoid deadlocks in console
 			 * drivers that queue work while holding locks
@@ -6595,6 +7065,32 @@ static void __init restrict_unbound_cpumask(const char *name, const struct cpuma
 	cpumask_and(wq_unbound_cpumask, wq_unbound_cpumask, mask);
 }
 
+static void __init init_cpu_worker_pool(struct worker_pool *pool, int cpu, int nice)
+{
+	BUG_ON(init_worker_pool(pool));
+	pool->cpu = cpu;
+	cpumask_copy(pool->attrs->cpumask, cpumask_of(cpu));
+	cpumask_copy(pool->attrs->__pod_cpumask, cpumask_of(cpu));
+	pool->attrs->nice = nice;
+	pool->attrs->affn_strict = true;
+	pool->node = cpu_to_node(cpu);
+
+	/* alloc pool ID */
+	mutex_lock(&wq_pool_mutex);
+	BUG_ON(worker_pool_assign_id(pool));
+	mutex_unlock(&wq_pool_mutex);
+}
+
+static void bh_pool_kick_normal(struct irq_work *irq_work)
+{
+	raise_softirq_irqoff(TASKLET_SOFTIRQ);
+}
+
+static void bh_pool_kick_highpri(struct irq_work *irq_work)
+{
+	raise_softirq_irqoff(HI_SOFTIRQ);
+}
+
 /**
  * workqueue_init_early - early init for workqueue subsystem
  *
@@ -6609,6 +7105,8 @@ void __init workqueue_init_early(void)
 {
 	struct wq_pod_type *pt = &wq_pod_types[WQ_AFFN_SYSTEM];
 	int std_nice[NR_STD_WORKER_POOLS] = { 0, HIGHPRI_NICE_LEVEL };
+	void (*irq_work_fns[2])(struct irq_work *) = { bh_pool_kick_normal,
+						       bh_pool_kick_highpri };
 	int i, cpu;
 
 	BUILD_BUG_ON(__alignof__(struct pool_workqueue) < __alignof__(long long));
@@ -6643,25 +7141,21 @@ void __init workqueue_init_early(void)
 	pt->pod_node[0] = NUMA_NO_NODE;
 	pt->cpu_pod[0] = 0;
 
-	/* initialize CPU pools */
+	/* initialize BH and CPU pools */
 	for_each_possible_cpu(cpu) {
 		struct worker_pool *pool;
 
 		i = 0;
-		for_each_cpu_worker_pool(pool, cpu) {
-			BUG_ON(init_worker_pool(pool));
-			pool->cpu = cpu;
-			cpumask_copy(pool->attrs->cpumask, cpumask_of(cpu));
-			cpumask_copy(pool->attrs->__pod_cpumask, cpumask_of(cpu));
-			pool->attrs->nice = std_nice[i++];
-			pool->attrs->affn_strict = true;
-			pool->node = cpu_to_node(cpu);
-
-			/* alloc pool ID */
-			mutex_lock(&wq_pool_mutex);
-			BUG_ON(worker_pool_assign_id(pool));
-			mutex_unlock(&wq_pool_mutex);
+		for_each_bh_worker_pool(pool, cpu) {
+			init_cpu_worker_pool(pool, cpu, std_nice[i]);
+			pool->flags |= POOL_BH;
+			init_irq_work(bh_pool_irq_work(pool), irq_work_fns[i]);
+			i++;
 		}
+
+		i = 0;
+		for_each_cpu_worker_pool(pool, cpu)
+			init_cpu_worker_pool(pool, cpu, std_nice[i++]);
 	}
 
 	/* create default unbound and ordered wq attrs */
@@ -6694,10 +7188,14 @@ void __init workqueue_init_early(void)
 	system_freezable_power_efficient_wq = alloc_workqueue("events_freezable_power_efficient",
 					      WQ_FREEZABLE | WQ_POWER_EFFICIENT,
 					      0);
+	system_bh_wq = alloc_workqueue("events_bh", WQ_BH, 0);
+	system_bh_highpri_wq = alloc_workqueue("events_bh_highpri",
+					       WQ_BH | WQ_HIGHPRI, 0);
 	BUG_ON(!system_wq || !system_highpri_wq || !system_long_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
 	       !system_power_efficient_wq ||
-	       !system_freezable_power_efficient_wq);
+	       !system_freezable_power_efficient_wq ||
+	       !system_bh_wq || !system_bh_highpri_wq);
 }
 
 static void __init wq_cpu_intensive_thresh_init(void)
@@ -6763,9 +7261,10 @@ void __init workqueue_init(void)
 	 * up. Also, create a rescuer for workqueues that requested it.
 	 */
 	for_each_possible_cpu(cpu) {
-		for_each_cpu_worker_pool(pool, cpu) {
+		for_each_bh_worker_pool(pool, cpu)
+			pool->node = cpu_to_node(cpu);
+		for_each_cpu_worker_pool(pool, cpu)
 			pool->node = cpu_to_node(cpu);
-		}
 	}
 
 	list_for_each_entry(wq, &workqueues, list) {
@@ -6776,7 +7275,14 @@ void __init workqueue_init(void)
 
 	mutex_unlock(&wq_pool_mutex);
 
-	/* create the initial workers */
+	/*
+	 * Create the initial workers. A BH pool has a single worker for the
+	 * whole lifetime of the system, also on CPUs which are offline now.
+	 */
+	for_each_possible_cpu(cpu)
+		for_each_bh_worker_pool(pool, cpu)
+			BUG_ON(!create_worker(pool));
+
 	for_each_online_cpu(cpu) {
 		for_each_cpu_worker_pool(pool, cpu) {
 			pool->flags &= ~POOL_DISASSOCIATED;
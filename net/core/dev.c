@@ -6348,17 +6348,50 @@ static enum hrtimer_restart napi_watchdog(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
-static void init_gro_hash(struct napi_struct *napi)
+/* Tables larger than the default are allocated, the default is inline */
+static struct gro_list *alloc_gro_hash(struct napi_struct *napi,
+				       unsigned int buckets)
+{
+	if (buckets <= ARRAY_SIZE(napi->gro_hash_inline))
+		return napi->gro_hash_inline;
+
+	return kcalloc(buckets, sizeof(struct gro_list), GFP_KERNEL);
+}
+
+static void free_gro_hash(struct napi_struct *napi)
+{
+	if (napi->gro_hash != napi->gro_hash_inline)
+		kfree(napi->gro_hash);
+	napi->gro_hash = napi->gro_hash_inline;
+	napi->gro_hash_buckets = ARRAY_SIZE(napi->gro_hash_inline);
+}
+
+static void set_gro_hash(struct napi_struct *napi, struct gro_list *hash,
+			 unsigned int buckets)
 {
 	int i;
 
-	for (i = 0; i < GRO_HASH_BUCKETS; i++) {
-		INIT_LIST_HEAD(&napi->gro_hash[i].list);
-		napi->gro_hash[i].count = 0;
+	for (i = 0; i < buckets; i++) {
+		INIT_LIST_HEAD(&hash[i].list);
+		hash[i].count = 0;
 	}
+	napi->gro_hash = hash;
+	napi->gro_hash_buckets = buckets;
 	napi->gro_bitmask = 0;
 }
 
+static void init_gro_hash(struct napi_struct *napi, unsigned int buckets)
+{
+	struct gro_list *hash = alloc_gro_hash(napi, buckets);
+
+	if (!hash) {
+		hash = napi->gro_hash_inline;
+		buckets = ARRAY_SIZE(napi->gro_hash_inline);
+	}
+	set_gro_hash(napi, hash, buckets);
+	u64_stats_init(&napi->gro_stats.syncp);
+}
+
 int dev_set_threaded(struct net_device *dev, bool threaded)
 {
 	struct napi_struct *napi;
@@ -6446,7 +6479,11 @@ void netif_napi_add_weight(struct net_device *dev, struct napi_struct *napi,
 	INIT_HLIST_NODE(&napi->napi_hash_node);
 	hrtimer_init(&napi->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
 	napi->timer.function = napi_watchdog;
-	init_gro_hash(napi);
+	init_gro_hash(napi, READ_ONCE(dev->gro_hash_buckets));
+	if (napi->gro_hash_buckets < READ_ONCE(dev->gro_hash_buckets))
+		netdev_warn(dev, "using %u GRO hash buckets instead of %u\n",
+			    napi->gro_hash_buckets,
+			    READ_ONCE(dev->gro_hash_buckets));
 	napi->skb = NULL;
 	INIT_LIST_HEAD(&napi->rx_list);
 	napi->rx_count = 0;
@@ -6524,7 +6561,7 @@ static void flush_gro_hash(struct napi_struct *napi)
 {
 	int i;
 
-	for (i = 0; i < GRO_HASH_BUCKETS; i++) {
+	for (i = 0; i < napi->gro_hash_buckets; i++) {
 		struct sk_buff *skb, *n;
 
 		list_for_each_entry_safe(skb, n, &napi->gro_hash[i].list, list)
@@ -6544,6 +6581,7 @@ void __netif_napi_del(struct napi_struct *napi)
 	napi_free_frags(napi);
 
 	flush_gro_hash(napi);
+	free_gro_hash(napi);
 	napi->gro_bitmask = 0;
 
 	if (napi->thread) {
@@ -6553,6 +6591,68 @@ void __netif_napi_del(struct napi_struct *napi)
 }
 EXPORT_SYMBOL(__netif_napi_del);
 
+/**
+ * dev_set_gro_hash_buckets - resize the GRO hash of every NAPI of a device
+ * @dev: network device, which must be down
+ * @buckets: number of buckets, a power of two up to GRO_HASH_BUCKETS
+ *
+ * The NAPI instances of a device that is down are disabled, so their tables
+ * can be swapped.  Packets still held in them are dropped.  Either every
+ * NAPI is resized or, on error, none is.
+ */
+int dev_set_gro_hash_buckets(struct net_device *dev, unsigned int buckets)
+{
+	struct napi_struct *napi;
+	struct gro_list **hash;
+	int i, n = 0;
+
+	ASSERT_RTNL();
+
+	if (!buckets || buckets > GRO_HASH_BUCKETS || !is_power_of_2(buckets))
+		return -EINVAL;
+
+	/*
+	 * Packets held by GRO would be looked up in another bucket than the
+	 * one they are in, and later packets of their flows be delivered
+	 * before them.
+	 */
+	if (netif_running(dev))
+		return -EBUSY;
+
+	list_for_each_entry(napi, &dev->napi_list, dev_list)
+		n++;
+
+	hash = kcalloc(n, sizeof(*hash), GFP_KERNEL);
+	if (n && !hash)
+		return -ENOMEM;
+
+	i = 0;
+	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		hash[i] = alloc_gro_hash(napi, buckets);
+		if (!hash[i])
+			goto err;
+		i++;
+	}
+
+	i = 0;
+	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		flush_gro_hash(napi);
+		free_gro_hash(napi);
+		set_gro_hash(napi, hash[i++], buckets);
+	}
+	WRITE_ONCE(dev->gro_hash_buckets, buckets);
+	kfree(hash);
+	return 0;
+
+err:
+	/* Only larger than inline tables can fail, the others are allocated */
+	while (i--)
+		kfree(hash[i]);
+	kfree(hash);
+	return -ENOMEM;
+}
+EXPORT_SYMBOL(dev_set_gro_hash_buckets);
+
 static int __napi_poll(struct napi_struct *n, bool *repoll)
 {
 	int work, weight;
@@ -10848,6 +10948,8 @@ struct net_device *alloc_netdev_mqs(int sizeof_priv, const char *name,
 	dev->gro_max_size = GRO_LEGACY_MAX_SIZE;
 	dev->gso_ipv4_max_size = GSO_LEGACY_MAX_SIZE;
 	dev->gro_ipv4_max_size = GRO_LEGACY_MAX_SIZE;
+	dev->gro_hash_buckets = GRO_HASH_BUCKETS_DEFAULT;
+	dev->gro_bucket_flows = GRO_BUCKET_FLOWS_DEFAULT;
 	dev->tso_max_size = TSO_LEGACY_MAX_SIZE;
 	dev->tso_max_segs = TSO_MAX_SEGS;
 	dev->upper_level = 1;
@@ -11651,6 +11753,8 @@ static void __init net_dev_struct_check(void)
 	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, napi_defer_hard_irqs);
 	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, gro_max_size);
 	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, gro_ipv4_max_size);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, gro_hash_buckets);
+	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, gro_bucket_flows);
 	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, rx_handler);
 	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, rx_handler_data);
 	CACHELINE_ASSERT_GROUP_MEMBER(struct net_device, net_device_read_rx, nd_net);
@@ -11719,7 +11823,7 @@ static int __init net_dev_init(void)
 		INIT_CSD(&sd->defer_csd, trigger_rx_softirq, sd);
 		spin_lock_init(&sd->defer_lock);
 
-		init_gro_hash(&sd->backlog);
+		init_gro_hash(&sd->backlog, GRO_HASH_BUCKETS_DEFAULT);
 		sd->backlog.poll = process_backlog;
 		sd->backlog.weight = weight_p;
 	}
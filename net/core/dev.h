@@ -36,10 +36,14 @@ void dev_addr_flush(struct net_device *dev);
 int dev_addr_init(struct net_device *dev);
 void dev_addr_check(struct net_device *dev);
 
+/* Size of the per-CPU page_pool deferred return cache */
+#define PAGE_POOL_DEFER_MAX	64
+
 /* sysctls not referred to from outside net/core/ */
 extern int		netdev_budget;
 extern unsigned int	netdev_budget_usecs;
 extern unsigned int	sysctl_skb_defer_max;
+extern unsigned int	sysctl_page_pool_defer_batch;
 extern int		netdev_tstamp_prequeue;
 extern int		netdev_unregister_timeout_secs;
 extern int		weight_p;
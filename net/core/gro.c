@@ -4,8 +4,6 @@
 #include <net/busy_poll.h>
 #include <trace/events/net.h>
 
-#define MAX_GRO_SKBS 8
-
 /* This should be increased if a protocol with a bigger head is added. */
 #define GRO_MAX_HEAD (MAX_HEADER + 128)
 
@@ -266,6 +264,11 @@ static void napi_gro_complete(struct napi_struct *napi, struct sk_buff *skb)
 	}
 
 out:
+	u64_stats_update_begin(&napi->gro_stats.syncp);
+	u64_stats_inc(&napi->gro_stats.flushes);
+	u64_stats_add(&napi->gro_stats.segs, NAPI_GRO_CB(skb)->count);
+	u64_stats_update_end(&napi->gro_stats.syncp);
+
 	gro_normal_one(napi, skb, NAPI_GRO_CB(skb)->count);
 }
 
@@ -276,8 +279,11 @@ static void __napi_gro_flush_chain(struct napi_struct *napi, u32 index,
 	struct sk_buff *skb, *p;
 
 	list_for_each_entry_safe_reverse(skb, p, head, list) {
+		/* The list is kept in LRU order rather than by age, so a
+		 * young packet does not mean everything before it is young.
+		 */
 		if (flush_old && NAPI_GRO_CB(skb)->age == jiffies)
-			return;
+			continue;
 		skb_list_del_init(skb);
 		napi_gro_complete(napi, skb);
 		napi->gro_hash[index].count--;
@@ -287,20 +293,17 @@ static void __napi_gro_flush_chain(struct napi_struct *napi, u32 index,
 		__clear_bit(index, &napi->gro_bitmask);
 }
 
-/* napi->gro_hash[].list contains packets ordered by age.
- * youngest packets at the head of it.
+/* napi->gro_hash[].list contains packets ordered by last merge,
+ * most recently merged packets at the head of it.
  * Complete skbs in reverse order to reduce latencies.
  */
 void napi_gro_flush(struct napi_struct *napi, bool flush_old)
 {
 	unsigned long bitmask = napi->gro_bitmask;
-	unsigned int i, base = ~0U;
+	unsigned int i;
 
-	while ((i = ffs(bitmask)) != 0) {
-		bitmask >>= i;
-		base += i;
-		__napi_gro_flush_chain(napi, base, flush_old);
-	}
+	for_each_set_bit(i, &bitmask, napi->gro_hash_buckets)
+		__napi_gro_flush_chain(napi, i, flush_old);
 }
 EXPORT_SYMBOL(napi_gro_flush);
 
@@ -421,12 +424,16 @@ static void gro_flush_oldest(struct napi_struct *napi, struct list_head *head)
 
 	oldest = list_last_entry(head, struct sk_buff, list);
 
-	/* We are called with head length >= MAX_GRO_SKBS, so this is
+	/* We are called with head length >= gro_bucket_flows, so this is
 	 * impossible.
 	 */
 	if (WARN_ON_ONCE(!oldest))
 		return;
 
+	u64_stats_update_begin(&napi->gro_stats.syncp);
+	u64_stats_inc(&napi->gro_stats.evictions);
+	u64_stats_update_end(&napi->gro_stats.syncp);
+
 	/* Do not adjust napi->gro_hash[].count, caller is adding a new
 	 * SKB to the chain.
 	 */
@@ -434,9 +441,28 @@ static void gro_flush_oldest(struct napi_struct *napi, struct list_head *head)
 	napi_gro_complete(napi, oldest);
 }
 
+/* Move the packet @skb was just merged into to the head of the bucket,
+ * so that eviction picks the least recently merged flow rather than the
+ * oldest one.  Protocol gro_receive handlers clear same_flow on every
+ * held packet that does not match, leaving only the merge target set.
+ */
+static void gro_list_touch(struct list_head *head)
+{
+	struct sk_buff *p;
+
+	list_for_each_entry(p, head, list) {
+		if (NAPI_GRO_CB(p)->same_flow) {
+			if (p->list.prev != head)
+				list_move(&p->list, head);
+			return;
+		}
+	}
+}
+
 static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
-	u32 bucket = skb_get_hash_raw(skb) & (GRO_HASH_BUCKETS - 1);
+	const struct net_device *dev = skb->dev;
+	u32 bucket = skb_get_hash_raw(skb) & (napi->gro_hash_buckets - 1);
 	struct gro_list *gro_list = &napi->gro_hash[bucket];
 	struct list_head *head = &offload_base;
 	struct packet_offload *ptype;
@@ -445,7 +471,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 	enum gro_result ret;
 	int same_flow;
 
-	if (netif_elide_gro(skb->dev))
+	if (netif_elide_gro(dev))
 		goto normal;
 
 	gro_list_prepare(&gro_list->list, skb);
@@ -507,13 +533,16 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 		gro_list->count--;
 	}
 
-	if (same_flow)
+	if (same_flow) {
+		if (!pp)
+			gro_list_touch(&gro_list->list);
 		goto ok;
+	}
 
 	if (NAPI_GRO_CB(skb)->flush)
 		goto normal;
 
-	if (unlikely(gro_list->count >= MAX_GRO_SKBS))
+	if (unlikely(gro_list->count >= READ_ONCE(dev->gro_bucket_flows)))
 		gro_flush_oldest(napi, &gro_list->list);
 	else
 		gro_list->count++;
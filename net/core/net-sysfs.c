@@ -23,6 +23,7 @@
 #include <linux/of.h>
 #include <linux/of_net.h>
 #include <linux/cpu.h>
+#include <linux/log2.h>
 #include <net/netdev_rx_queue.h>
 
 #include "dev.h"
@@ -434,6 +435,45 @@ static ssize_t napi_defer_hard_irqs_store(struct device *dev,
 }
 NETDEVICE_SHOW_RW(napi_defer_hard_irqs, fmt_dec);
 
+static int change_gro_hash_buckets(struct net_device *dev, unsigned long val)
+{
+	if (val > GRO_HASH_BUCKETS)
+		return -EINVAL;
+
+	return dev_set_gro_hash_buckets(dev, val);
+}
+
+static ssize_t gro_hash_buckets_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len, change_gro_hash_buckets);
+}
+NETDEVICE_SHOW_RW(gro_hash_buckets, fmt_dec);
+
+static int change_gro_bucket_flows(struct net_device *dev, unsigned long val)
+{
+	if (!val || val > GRO_BUCKET_FLOWS_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(dev->gro_bucket_flows, val);
+	return 0;
+}
+
+static ssize_t gro_bucket_flows_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len, change_gro_bucket_flows);
+}
+NETDEVICE_SHOW_RW(gro_bucket_flows, fmt_dec);
+
 static ssize_t ifalias_store(struct device *dev, struct device_attribute *attr,
 			     const char *buf, size_t len)
 {
@@ -658,6 +698,8 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_tx_queue_len.attr,
 	&dev_attr_gro_flush_timeout.attr,
 	&dev_attr_napi_defer_hard_irqs.attr,
+	&dev_attr_gro_hash_buckets.attr,
+	&dev_attr_gro_bucket_flows.attr,
 	&dev_attr_phys_port_id.attr,
 	&dev_attr_phys_port_name.attr,
 	&dev_attr_phys_switch_id.attr,
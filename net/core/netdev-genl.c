@@ -158,6 +158,28 @@ int netdev_nl_dev_get_dumpit(struct sk_buff *skb, struct netlink_callback *cb)
 	return skb->len;
 }
 
+static int
+netdev_nl_napi_fill_gro_stats(struct sk_buff *rsp, struct napi_struct *napi)
+{
+	const struct napi_gro_stats *stats = &napi->gro_stats;
+	u64 flushes, segs, evictions;
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&stats->syncp);
+		flushes = u64_stats_read(&stats->flushes);
+		segs = u64_stats_read(&stats->segs);
+		evictions = u64_stats_read(&stats->evictions);
+	} while (u64_stats_fetch_retry(&stats->syncp, start));
+
+	if (nla_put_uint(rsp, NETDEV_A_NAPI_GRO_FLUSHES, flushes) ||
+	    nla_put_uint(rsp, NETDEV_A_NAPI_GRO_SEGS, segs) ||
+	    nla_put_uint(rsp, NETDEV_A_NAPI_GRO_EVICTIONS, evictions))
+		return -EMSGSIZE;
+
+	return 0;
+}
+
 static int
 netdev_nl_napi_fill_one(struct sk_buff *rsp, struct napi_struct *napi,
 			const struct genl_info *info)
@@ -190,6 +212,9 @@ netdev_nl_napi_fill_one(struct sk_buff *rsp, struct napi_struct *napi,
 			goto nla_put_failure;
 	}
 
+	if (netdev_nl_napi_fill_gro_stats(rsp, napi))
+		goto nla_put_failure;
+
 	genlmsg_end(rsp, hdr);
 
 	return 0;
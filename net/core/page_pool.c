@@ -20,10 +20,14 @@
 #include <linux/poison.h>
 #include <linux/ethtool.h>
 #include <linux/netdevice.h>
+#include <linux/cpuhotplug.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include <trace/events/page_pool.h>
 
 #include "page_pool_priv.h"
+#include "dev.h"
 
 #define DEFER_TIME (msecs_to_jiffies(1000))
 #define DEFER_WARN_INTERVAL (60 * HZ)
@@ -46,6 +50,22 @@
 		this_cpu_add(s->__stat, val);						\
 	} while (0)
 
+/* Where the pages handed back to page_pool came from, across all pools.
+ * Exported per CPU through /proc/net/stat/page_pool.
+ */
+struct page_pool_return_stats {
+	unsigned long direct;		/* owning NAPI, into the alloc cache */
+	unsigned long softirq;		/* softirq, not the owning NAPI */
+	unsigned long process;		/* process context */
+	unsigned long deferred;		/* parked in the per-CPU defer cache */
+	unsigned long defer_flush;	/* defer cache batches handed back */
+};
+
+static DEFINE_PER_CPU(struct page_pool_return_stats, pp_return_stats);
+
+#define return_stat_inc(__stat)		this_cpu_inc(pp_return_stats.__stat)
+#define return_stat_add(__stat, val)	this_cpu_add(pp_return_stats.__stat, val)
+
 static const char pp_stats[][ETH_GSTRING_LEN] = {
 	"rx_pp_alloc_fast",
 	"rx_pp_alloc_slow",
@@ -141,10 +161,75 @@ u64 *page_pool_ethtool_stats_get(u64 *data, void *stats)
 }
 EXPORT_SYMBOL(page_pool_ethtool_stats_get);
 
+static void *page_pool_stat_seq_start(struct seq_file *seq, loff_t *pos)
+{
+	int cpu;
+
+	if (*pos == 0)
+		return SEQ_START_TOKEN;
+
+	for (cpu = *pos - 1; cpu < nr_cpu_ids; ++cpu) {
+		if (!cpu_possible(cpu))
+			continue;
+		*pos = cpu + 1;
+		return per_cpu_ptr(&pp_return_stats, cpu);
+	}
+	return NULL;
+}
+
+static void *page_pool_stat_seq_next(struct seq_file *seq, void *v, loff_t *pos)
+{
+	int cpu;
+
+	for (cpu = *pos; cpu < nr_cpu_ids; ++cpu) {
+		if (!cpu_possible(cpu))
+			continue;
+		*pos = cpu + 1;
+		return per_cpu_ptr(&pp_return_stats, cpu);
+	}
+	(*pos)++;
+	return NULL;
+}
+
+static void page_pool_stat_seq_stop(struct seq_file *seq, void *v)
+{
+}
+
+static int page_pool_stat_seq_show(struct seq_file *seq, void *v)
+{
+	struct page_pool_return_stats *st = v;
+
+	if (v == SEQ_START_TOKEN) {
+		seq_puts(seq, "direct   softirq  process  deferred defer_flush\n");
+		return 0;
+	}
+
+	seq_printf(seq, "%08lx %08lx %08lx %08lx %08lx\n",
+		   st->direct, st->softirq, st->process,
+		   st->deferred, st->defer_flush);
+	return 0;
+}
+
+static const struct seq_operations page_pool_stat_seq_ops = {
+	.start	= page_pool_stat_seq_start,
+	.next	= page_pool_stat_seq_next,
+	.stop	= page_pool_stat_seq_stop,
+	.show	= page_pool_stat_seq_show,
+};
+
+static void page_pool_stat_proc_init(void)
+{
+	proc_create_seq("page_pool", 0444, init_net.proc_net_stat,
+			&page_pool_stat_seq_ops);
+}
+
 #else
 #define alloc_stat_inc(pool, __stat)
 #define recycle_stat_inc(pool, __stat)
 #define recycle_stat_add(pool, __stat, val)
+#define return_stat_inc(__stat)
+#define return_stat_add(__stat, val)
+#define page_pool_stat_proc_init()
 #endif
 
 static bool page_pool_producer_lock(struct page_pool *pool)
@@ -623,6 +708,107 @@ static bool page_pool_recycle_in_cache(struct page *page,
 	return true;
 }
 
+/* Pages released outside of the owning NAPI context have to go back
+ * through the ptr_ring, whose producer lock is shared by every CPU
+ * freeing into the pool.  Park them in a small per-CPU cache instead and
+ * hand them back in batches, taking the producer lock once per run of
+ * pages belonging to the same pool.
+ */
+struct page_pool_defer {
+	unsigned int		count;
+	struct page		*cache[PAGE_POOL_DEFER_MAX];
+	struct work_struct	flush_work;
+};
+
+static DEFINE_PER_CPU(struct page_pool_defer, page_pool_defer);
+
+unsigned int sysctl_page_pool_defer_batch __read_mostly = 32;
+
+/* Caller must have BH disabled, and own @defer: either it is the local
+ * CPU's cache, or the CPU it belongs to is dead.
+ */
+static void page_pool_defer_flush(struct page_pool_defer *defer)
+{
+	unsigned int i = 0, count = defer->count;
+
+	if (!count)
+		return;
+
+	defer->count = 0;
+	return_stat_inc(defer_flush);
+
+	while (i < count) {
+		struct page_pool *pool = defer->cache[i]->pp;
+		unsigned int start = i;
+
+		spin_lock(&pool->ring.producer_lock);
+		for (; i < count && defer->cache[i]->pp == pool; i++) {
+			if (__ptr_ring_produce(&pool->ring, defer->cache[i]))
+				break;
+		}
+		recycle_stat_add(pool, ring, i - start);
+		spin_unlock(&pool->ring.producer_lock);
+
+		/* ptr_ring full, release the rest of this run outside the
+		 * producer lock.  Every page still held keeps the pool
+		 * alive, so @pool may be used up to the last one.
+		 */
+		for (; i < count && defer->cache[i]->pp == pool; i++) {
+			recycle_stat_inc(pool, ring_full);
+			page_pool_return_page(pool, defer->cache[i]);
+		}
+	}
+}
+
+static bool page_pool_recycle_in_defer(struct page *page)
+{
+	unsigned int batch = READ_ONCE(sysctl_page_pool_defer_batch);
+	struct page_pool_defer *defer;
+
+	if (!batch)
+		return false;
+
+	local_bh_disable();
+	defer = this_cpu_ptr(&page_pool_defer);
+	defer->cache[defer->count++] = page;
+	if (defer->count >= batch)
+		page_pool_defer_flush(defer);
+	local_bh_enable();
+
+	return_stat_inc(deferred);
+	return true;
+}
+
+static void page_pool_defer_flush_work(struct work_struct *work)
+{
+	local_bh_disable();
+	page_pool_defer_flush(this_cpu_ptr(&page_pool_defer));
+	local_bh_enable();
+}
+
+/* Ask every CPU holding deferred pages to give them back, so that a pool
+ * being destroyed does not wait for traffic that may never come.
+ */
+static void page_pool_defer_kick(void)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		struct page_pool_defer *defer = per_cpu_ptr(&page_pool_defer, cpu);
+
+		if (READ_ONCE(defer->count))
+			schedule_work_on(cpu, &defer->flush_work);
+	}
+}
+
+static int page_pool_defer_cpu_dead(unsigned int cpu)
+{
+	local_bh_disable();
+	page_pool_defer_flush(per_cpu_ptr(&page_pool_defer, cpu));
+	local_bh_enable();
+	return 0;
+}
+
 /* If the page refcnt == 1, this will try to recycle the page.
  * if PP_FLAG_DMA_SYNC_DEV is set, we'll try to sync the DMA area for
  * the configured size min(dma_sync_size, pool->max_len).
@@ -652,8 +838,10 @@ __page_pool_put_page(struct page_pool *pool, struct page *page,
 						      dma_sync_size);
 
 		if (allow_direct && in_softirq() &&
-		    page_pool_recycle_in_cache(page, pool))
+		    page_pool_recycle_in_cache(page, pool)) {
+			return_stat_inc(direct);
 			return NULL;
+		}
 
 		/* Page found as candidate for recycling */
 		return page;
@@ -681,7 +869,18 @@ void page_pool_put_defragged_page(struct page_pool *pool, struct page *page,
 				  unsigned int dma_sync_size, bool allow_direct)
 {
 	page = __page_pool_put_page(pool, page, dma_sync_size, allow_direct);
-	if (page && !page_pool_recycle_in_ring(pool, page)) {
+	if (!page)
+		return;
+
+	if (in_softirq())
+		return_stat_inc(softirq);
+	else
+		return_stat_inc(process);
+
+	if (page_pool_recycle_in_defer(page))
+		return;
+
+	if (!page_pool_recycle_in_ring(pool, page)) {
 		/* Cache full, fallback to free pages */
 		recycle_stat_inc(pool, ring_full);
 		page_pool_return_page(pool, page);
@@ -728,6 +927,10 @@ void page_pool_put_page_bulk(struct page_pool *pool, void **data,
 
 	/* Bulk producer into ptr_ring page_pool cache */
 	in_softirq = page_pool_producer_lock(pool);
+	if (in_softirq)
+		return_stat_add(softirq, bulk_len);
+	else
+		return_stat_add(process, bulk_len);
 	for (i = 0; i < bulk_len; i++) {
 		if (__ptr_ring_produce(&pool->ring, data[i])) {
 			/* ring full */
@@ -916,6 +1119,7 @@ static void page_pool_release_retry(struct work_struct *wq)
 	}
 
 	/* Still not ready to be disconnected, retry later */
+	page_pool_defer_kick();
 	schedule_delayed_work(&pool->release_dw, DEFER_TIME);
 }
 
@@ -960,6 +1164,7 @@ void page_pool_destroy(struct page_pool *pool)
 	pool->defer_start = jiffies;
 	pool->defer_warn  = jiffies + DEFER_WARN_INTERVAL;
 
+	page_pool_defer_kick();
 	INIT_DELAYED_WORK(&pool->release_dw, page_pool_release_retry);
 	schedule_delayed_work(&pool->release_dw, DEFER_TIME);
 }
@@ -980,3 +1185,20 @@ void page_pool_update_nid(struct page_pool *pool, int new_nid)
 	}
 }
 EXPORT_SYMBOL(page_pool_update_nid);
+
+static int __init page_pool_defer_init(void)
+{
+	int cpu, ret;
+
+	for_each_possible_cpu(cpu)
+		INIT_WORK(&per_cpu_ptr(&page_pool_defer, cpu)->flush_work,
+			  page_pool_defer_flush_work);
+
+	ret = cpuhp_setup_state_nocalls(CPUHP_BP_PREPARE_DYN, "net/page_pool:dead",
+					NULL, page_pool_defer_cpu_dead);
+	WARN_ON(ret < 0);
+
+	page_pool_stat_proc_init();
+	return 0;
+}
+subsys_initcall(page_pool_defer_init);
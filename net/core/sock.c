@@ -289,6 +289,12 @@ EXPORT_SYMBOL(sysctl_optmem_max);
 
 int sysctl_tstamp_allow_data __read_mostly = 1;
 
+/* Pages of protocol memory each cpu may charge or uncharge before
+ * folding them into the global prot->memory_allocated counter.
+ */
+int sysctl_mem_pcpu_rsv __read_mostly = SK_MEMORY_PCPU_RESERVE;
+EXPORT_SYMBOL(sysctl_mem_pcpu_rsv);
+
 DEFINE_STATIC_KEY_FALSE(memalloc_socks_key);
 EXPORT_SYMBOL_GPL(memalloc_socks_key);
 
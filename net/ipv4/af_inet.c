@@ -849,6 +849,29 @@ int inet_sendmsg(struct socket *sock, struct msghdr *msg, size_t size)
 }
 EXPORT_SYMBOL(inet_sendmsg);
 
+int inet_sendmmsg(struct socket *sock, struct msghdr *msgs, unsigned int vlen)
+{
+	struct sock *sk = sock->sk;
+	unsigned int sent;
+	int err;
+
+	if (unlikely(inet_send_prepare(sk)))
+		return -EAGAIN;
+
+	if (sk->sk_prot->sendmmsg)
+		return sk->sk_prot->sendmmsg(sk, msgs, vlen);
+
+	for (sent = 0; sent < vlen; sent++) {
+		err = sk->sk_prot->sendmsg(sk, &msgs[sent],
+					   msg_data_left(&msgs[sent]));
+		if (err < 0)
+			return sent ? sent : err;
+	}
+
+	return sent;
+}
+EXPORT_SYMBOL(inet_sendmmsg);
+
 void inet_splice_eof(struct socket *sock)
 {
 	const struct proto *prot;
@@ -1096,6 +1119,7 @@ const struct proto_ops inet_dgram_ops = {
 	.setsockopt	   = sock_common_setsockopt,
 	.getsockopt	   = sock_common_getsockopt,
 	.sendmsg	   = inet_sendmsg,
+	.sendmmsg	   = inet_sendmmsg,
 	.read_skb	   = udp_read_skb,
 	.recvmsg	   = inet_recvmsg,
 	.mmap		   = sock_no_mmap,
@@ -137,6 +137,7 @@
 #include <net/checksum.h>
 #include <net/inet_ecn.h>
 #include <linux/netfilter_ipv4.h>
+#include <net/tcp.h>
 #include <net/xfrm.h>
 #include <linux/mroute.h>
 #include <linux/netlink.h>
@@ -571,14 +572,90 @@ int ip_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt,
 		       ip_rcv_finish);
 }
 
+static void ip_list_local_deliver_finish(struct net *net,
+					 struct list_head *head)
+{
+	struct sk_buff *skb, *next;
+	struct list_head sublist;
+
+	INIT_LIST_HEAD(&sublist);
+	rcu_read_lock();
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+		skb_clear_delivery_time(skb);
+		__skb_pull(skb, skb_network_header_len(skb));
+
+		/* TCP has no_policy set, so raw delivery is all that
+		 * ip_protocol_deliver_rcu() would do before tcp_v4_rcv().
+		 */
+		if (ip_hdr(skb)->protocol == IPPROTO_TCP) {
+			raw_local_deliver(skb, IPPROTO_TCP);
+			__IP_INC_STATS(net, IPSTATS_MIB_INDELIVERS);
+			list_add_tail(&skb->list, &sublist);
+			continue;
+		}
+
+		/* keep ordering with the pending TCP segments */
+		if (!list_empty(&sublist)) {
+			tcp_v4_rcv_list(&sublist);
+			INIT_LIST_HEAD(&sublist);
+		}
+		ip_protocol_deliver_rcu(net, skb, ip_hdr(skb)->protocol);
+	}
+	if (!list_empty(&sublist))
+		tcp_v4_rcv_list(&sublist);
+	rcu_read_unlock();
+}
+
+static void ip_list_local_deliver(struct net *net, struct net_device *dev,
+				  struct list_head *head)
+{
+	NF_HOOK_LIST(NFPROTO_IPV4, NF_INET_LOCAL_IN, net, NULL,
+		     head, dev, NULL, ip_local_deliver_finish);
+	ip_list_local_deliver_finish(net, head);
+}
+
+/* Deliver a sublist sharing one dst.  Unfragmented local traffic stays
+ * batched up to the transport layer, everything else is handed to the
+ * dst one skb at a time.
+ */
 static void ip_sublist_rcv_finish(struct list_head *head)
 {
 	struct sk_buff *skb, *next;
+	struct list_head local;
+	struct net_device *dev;
+	struct net *net;
+
+	if (list_empty(head))
+		return;
+
+	skb = list_first_entry(head, struct sk_buff, list);
+	if (skb_dst(skb)->input != ip_local_deliver) {
+		list_for_each_entry_safe(skb, next, head, list) {
+			skb_list_del_init(skb);
+			dst_input(skb);
+		}
+		return;
+	}
 
+	dev = skb->dev;
+	net = dev_net(dev);
+	INIT_LIST_HEAD(&local);
 	list_for_each_entry_safe(skb, next, head, list) {
 		skb_list_del_init(skb);
-		dst_input(skb);
+		if (!ip_is_fragment(ip_hdr(skb))) {
+			list_add_tail(&skb->list, &local);
+			continue;
+		}
+		/* keep ordering with the pending batch */
+		if (!list_empty(&local)) {
+			ip_list_local_deliver(net, dev, &local);
+			INIT_LIST_HEAD(&local);
+		}
+		ip_local_deliver(skb);
 	}
+	if (!list_empty(&local))
+		ip_list_local_deliver(net, dev, &local);
 }
 
 static struct sk_buff *ip_extract_route_hint(const struct net *net,
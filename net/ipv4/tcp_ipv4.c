@@ -2164,6 +2164,45 @@ static void tcp_v4_fill_cb(struct sk_buff *skb, const struct iphdr *iph,
  *	From tcp_input.c
  */
 
+/* Checks applied to every segment before it is handed to a full socket.
+ * Returns a drop reason, or SKB_NOT_DROPPED_YET once the TCP control
+ * block has been filled in.
+ */
+static enum skb_drop_reason tcp_v4_rcv_sk_checks(struct sock *sk,
+						  struct sk_buff *skb,
+						  int dif, int sdif)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	enum skb_drop_reason drop_reason;
+
+	if (static_branch_unlikely(&ip4_min_ttl)) {
+		/* min_ttl can be changed concurrently from do_ip_setsockopt() */
+		if (unlikely(iph->ttl < READ_ONCE(inet_sk(sk)->min_ttl))) {
+			__NET_INC_STATS(sock_net(sk), LINUX_MIB_TCPMINTTLDROP);
+			return SKB_DROP_REASON_TCP_MINTTL;
+		}
+	}
+
+	if (!xfrm4_policy_check(sk, XFRM_POLICY_IN, skb))
+		return SKB_DROP_REASON_XFRM_POLICY;
+
+	drop_reason = tcp_inbound_hash(sk, NULL, skb, &iph->saddr, &iph->daddr,
+				       AF_INET, dif, sdif);
+	if (drop_reason)
+		return drop_reason;
+
+	nf_reset_ct(skb);
+
+	if (tcp_filter(sk, skb))
+		return SKB_DROP_REASON_SOCKET_FILTER;
+
+	tcp_v4_fill_cb(skb, ip_hdr(skb), (const struct tcphdr *)skb->data);
+
+	skb->dev = NULL;
+
+	return SKB_NOT_DROPPED_YET;
+}
+
 int tcp_v4_rcv(struct sk_buff *skb)
 {
 	struct net *net = dev_net(skb->dev);
@@ -2290,37 +2329,10 @@ int tcp_v4_rcv(struct sk_buff *skb)
 		}
 	}
 
-	if (static_branch_unlikely(&ip4_min_ttl)) {
-		/* min_ttl can be changed concurrently from do_ip_setsockopt() */
-		if (unlikely(iph->ttl < READ_ONCE(inet_sk(sk)->min_ttl))) {
-			__NET_INC_STATS(net, LINUX_MIB_TCPMINTTLDROP);
-			drop_reason = SKB_DROP_REASON_TCP_MINTTL;
-			goto discard_and_relse;
-		}
-	}
-
-	if (!xfrm4_policy_check(sk, XFRM_POLICY_IN, skb)) {
-		drop_reason = SKB_DROP_REASON_XFRM_POLICY;
-		goto discard_and_relse;
-	}
-
-	drop_reason = tcp_inbound_hash(sk, NULL, skb, &iph->saddr, &iph->daddr,
-				       AF_INET, dif, sdif);
+	drop_reason = tcp_v4_rcv_sk_checks(sk, skb, dif, sdif);
 	if (drop_reason)
 		goto discard_and_relse;
 
-	nf_reset_ct(skb);
-
-	if (tcp_filter(sk, skb)) {
-		drop_reason = SKB_DROP_REASON_SOCKET_FILTER;
-		goto discard_and_relse;
-	}
-	th = (const struct tcphdr *)skb->data;
-	iph = ip_hdr(skb);
-	tcp_v4_fill_cb(skb, iph, th);
-
-	skb->dev = NULL;
-
 	if (sk->sk_state == TCP_LISTEN) {
 		ret = tcp_v4_do_rcv(sk, skb);
 		goto put_and_return;
@@ -2419,6 +2431,185 @@ int tcp_v4_rcv(struct sk_buff *skb)
 	goto discard_it;
 }
 
+/* Find the socket for a segment of a receive batch.  Returns a full,
+ * non-listening socket with a reference held on behalf of the batch, or
+ * NULL if the segment must take the tcp_v4_rcv() path.  Segments of the
+ * flow currently being batched (@curr_sk) reuse its reference instead
+ * of looking the socket up again.
+ */
+static struct sock *tcp_v4_rcv_list_sk(struct sk_buff *skb,
+				       struct sock *curr_sk)
+{
+	struct net *net = dev_net(skb->dev);
+	int sdif = inet_sdif(skb);
+	int dif = inet_iif(skb);
+	const struct iphdr *iph;
+	const struct tcphdr *th;
+	struct sock *sk;
+
+	if (skb->pkt_type != PACKET_HOST ||
+	    !pskb_may_pull(skb, sizeof(struct tcphdr)))
+		return NULL;
+
+	th = (const struct tcphdr *)skb->data;
+	if (unlikely(th->doff < sizeof(struct tcphdr) / 4) ||
+	    !pskb_may_pull(skb, th->doff * 4))
+		return NULL;
+
+	th = (const struct tcphdr *)skb->data;
+	iph = ip_hdr(skb);
+
+	sk = skb->sk;
+	if (sk) {
+		bool refcounted, prefetched;
+
+		/* Early demux already did the lookup, keep its reference.
+		 * Leave anything unusual to tcp_v4_rcv().
+		 */
+		if (skb_sk_is_prefetched(skb) || !sk_fullsock(sk) ||
+		    sk->sk_state == TCP_LISTEN || sk->sk_state == TCP_CLOSE)
+			return NULL;
+
+		skb_steal_sock(skb, &refcounted, &prefetched);
+		if (sk == curr_sk)
+			sock_put(sk);
+		return sk;
+	}
+
+	if (curr_sk && curr_sk->sk_state != TCP_CLOSE) {
+		INET_ADDR_COOKIE(acookie, iph->saddr, iph->daddr);
+		const __portpair ports = INET_COMBINED_PORTS(th->source,
+							     ntohs(th->dest));
+
+		if (inet_match(net, curr_sk, acookie, ports, dif, sdif))
+			return curr_sk;
+	}
+
+	sk = __inet_lookup_established(net, net->ipv4.tcp_death_row.hashinfo,
+				       iph->saddr, th->source,
+				       iph->daddr, ntohs(th->dest), dif, sdif);
+	if (sk && !sk_fullsock(sk)) {
+		sock_gen_put(sk);
+		sk = NULL;
+	} else if (sk == curr_sk) {
+		/* curr_sk was not matched above, the batch already holds it */
+		sock_put(sk);
+	}
+
+	return sk;
+}
+
+/* Whether processing @skb may change the state of @sk so that later
+ * segments of its flow no longer belong to it (e.g. it moves to
+ * TIME_WAIT), in which case they must be looked up again.
+ */
+static bool tcp_v4_rcv_list_ends_batch(const struct sock *sk,
+				       const struct sk_buff *skb)
+{
+	const struct tcphdr *th = (const struct tcphdr *)skb->data;
+
+	return READ_ONCE(sk->sk_state) != TCP_ESTABLISHED ||
+	       th->syn || th->fin || th->rst;
+}
+
+/* Feed a batch of segments for one socket to it under a single
+ * acquisition of the socket lock.  Consumes the batch reference on @sk.
+ */
+static void tcp_v4_rcv_sublist(struct sock *sk, struct list_head *head)
+{
+	enum skb_drop_reason drop_reason;
+	struct sk_buff *skb, *next;
+
+	list_for_each_entry_safe(skb, next, head, list) {
+		struct net *net = dev_net(skb->dev);
+
+		/* Count it even if it's bad */
+		__TCP_INC_STATS(net, TCP_MIB_INSEGS);
+
+		if (skb_checksum_init(skb, IPPROTO_TCP, inet_compute_pseudo)) {
+			trace_tcp_bad_csum(skb);
+			__TCP_INC_STATS(net, TCP_MIB_CSUMERRORS);
+			__TCP_INC_STATS(net, TCP_MIB_INERRS);
+			drop_reason = SKB_DROP_REASON_TCP_CSUM;
+			goto drop;
+		}
+
+		drop_reason = tcp_v4_rcv_sk_checks(sk, skb, inet_iif(skb),
+						   inet_sdif(skb));
+		if (!drop_reason)
+			continue;
+drop:
+		skb_list_del_init(skb);
+		sk_drops_add(sk, skb);
+		kfree_skb_reason(skb, drop_reason);
+	}
+
+	if (list_empty(head))
+		goto out;
+
+	sk_incoming_cpu_update(sk);
+
+	bh_lock_sock_nested(sk);
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+		tcp_segs_in(tcp_sk(sk), skb);
+		if (!sock_owned_by_user(sk)) {
+			tcp_v4_do_rcv(sk, skb);
+		} else if (tcp_add_backlog(sk, skb, &drop_reason)) {
+			/* tcp_add_backlog() dropped the socket lock */
+			sk_drops_add(sk, skb);
+			kfree_skb_reason(skb, drop_reason);
+			bh_lock_sock_nested(sk);
+		}
+	}
+	bh_unlock_sock(sk);
+out:
+	sock_put(sk);
+}
+
+/* List receive entry, called from ip_list_rcv() for locally delivered
+ * segments with the RCU read lock held.  Consecutive segments of the
+ * same established flow share one socket lookup and one socket lock
+ * acquisition; everything else goes through tcp_v4_rcv() in order.
+ * A segment which may change the state of the socket ends the batch,
+ * so that the segments after it are matched against the new state.
+ */
+void tcp_v4_rcv_list(struct list_head *head)
+{
+	struct sock *curr_sk = NULL;
+	struct sk_buff *skb, *next;
+	struct list_head sublist;
+
+	INIT_LIST_HEAD(&sublist);
+	list_for_each_entry_safe(skb, next, head, list) {
+		struct sock *sk;
+
+		skb_list_del_init(skb);
+		sk = tcp_v4_rcv_list_sk(skb, curr_sk);
+		if (sk != curr_sk) {
+			/* dispatch old sublist */
+			if (curr_sk)
+				tcp_v4_rcv_sublist(curr_sk, &sublist);
+			/* start new sublist */
+			INIT_LIST_HEAD(&sublist);
+			curr_sk = sk;
+		}
+		if (!sk) {
+			tcp_v4_rcv(skb);
+			continue;
+		}
+		list_add_tail(&skb->list, &sublist);
+		if (tcp_v4_rcv_list_ends_batch(sk, skb)) {
+			tcp_v4_rcv_sublist(sk, &sublist);
+			INIT_LIST_HEAD(&sublist);
+			curr_sk = NULL;
+		}
+	}
+	/* dispatch final sublist */
+	if (curr_sk)
+		tcp_v4_rcv_sublist(curr_sk, &sublist);
+}
+
 static struct timewait_sock_ops tcp_timewait_sock_ops = {
 	.twsk_obj_size	= sizeof(struct tcp_timewait_sock),
 	.twsk_unique	= tcp_twsk_unique,
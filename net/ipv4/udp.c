@@ -1314,6 +1314,206 @@ int udp_sendmsg(struct sock *sk, struct msghdr *msg, size_t len)
 }
 EXPORT_SYMBOL(udp_sendmsg);
 
+/*
+ * sendmmsg() batching: on a connected socket, consecutive datagrams of a
+ * sendmmsg() call sharing the size of the first one (the last one may be
+ * shorter) are appended to one corked skb, sent with UDP_SEGMENT
+ * semantics. Route and neighbour are resolved once for the whole batch,
+ * and the device, or software GSO right before it, splits it back into
+ * the original datagrams. The batch is pushed before udp_sendmmsg()
+ * returns, and its datagrams only count as sent if the push succeeded.
+ */
+static bool udp_batch_msg_ok(const struct msghdr *msg, size_t len)
+{
+	if (msg->msg_name || msg->msg_controllen ||
+	    msg->msg_flags & (MSG_OOB | MSG_MORE | MSG_CONFIRM | MSG_PROBE |
+			      MSG_DONTROUTE | MSG_ZEROCOPY))
+		return false;
+
+	return len && len <= 0xFFFF;
+}
+
+/* The cached route, if a batch of @len byte datagrams can use it */
+static struct rtable *udp_batch_route(struct sock *sk, size_t len)
+{
+	const struct inet_sock *inet = inet_sk(sk);
+	const struct net_device *dev;
+	struct rtable *rt;
+
+	if (sk->sk_state != TCP_ESTABLISHED || udp_test_bit(CORK, sk) ||
+	    READ_ONCE(udp_sk(sk)->gso_size) || IS_UDPLITE(sk) ||
+	    sk->sk_no_check_tx || sock_flag(sk, SOCK_LOCALROUTE) ||
+	    ipv4_is_multicast(inet->inet_daddr) ||
+	    rcu_access_pointer(inet->inet_opt) ||
+	    READ_ONCE(sk->sk_tsflags) & SOF_TIMESTAMPING_TX_RECORD_MASK)
+		return NULL;
+
+	rt = (struct rtable *)sk_dst_check(sk, 0);
+	if (!rt)
+		return NULL;
+
+	dev = rt->dst.dev;
+	if (dst_xfrm(&rt->dst) ||
+	    !(dev->features & (NETIF_F_HW_CSUM | NETIF_F_IP_CSUM)) ||
+	    sizeof(struct iphdr) + sizeof(struct udphdr) + len >
+	    min(dst_mtu(&rt->dst), READ_ONCE(dev->mtu))) {
+		ip_rt_put(rt);
+		return NULL;
+	}
+
+	return rt;
+}
+
+/*
+ * Remove the partially appended datagram after @tail, which was @len long,
+ * from a batch.
+ */
+static void udp_batch_trim(struct sock *sk, struct sk_buff *tail,
+			   unsigned int len)
+{
+	struct sk_buff *skb;
+
+	while ((skb = skb_peek_tail(&sk->sk_write_queue)) != tail) {
+		__skb_unlink(skb, &sk->sk_write_queue);
+		kfree_skb(skb);
+	}
+	pskb_trim(tail, len);
+}
+
+/*
+ * Send a batch starting at @msgs[0]. Returns the number of datagrams
+ * sent, 0 if @msgs[0] can't start a batch, or the error sending it.
+ */
+static int udp_sendmmsg_batch(struct sock *sk, struct msghdr *msgs,
+			      unsigned int vlen)
+{
+	struct inet_sock *inet = inet_sk(sk);
+	struct udp_sock *up = udp_sk(sk);
+	size_t gso_size = msg_data_left(&msgs[0]);
+	struct ipcm_cookie ipc;
+	unsigned int max_len;
+	struct flowi4 *fl4;
+	struct rtable *rt;
+	unsigned int n;
+	int err = 0;
+
+	if (vlen < 2 || !udp_batch_msg_ok(&msgs[0], gso_size))
+		return 0;
+
+	rt = udp_batch_route(sk, gso_size);
+	if (!rt)
+		return 0;
+
+	ipcm_init_sk(&ipc, inet);
+	ipc.addr = inet->inet_daddr;
+	ipc.gso_size = gso_size;
+	max_len = min_t(unsigned int,
+			sizeof(struct udphdr) + gso_size * UDP_MAX_SEGMENTS,
+			IP_MAX_MTU - sizeof(struct iphdr));
+
+	lock_sock(sk);
+	/* Corked by MSG_MORE, or UDP_CORK set meanwhile */
+	if (unlikely(up->pending || udp_test_bit(CORK, sk))) {
+		release_sock(sk);
+		ip_rt_put(rt);
+		return 0;
+	}
+
+	fl4 = &inet->cork.fl.u.ip4;
+	fl4->daddr = inet->inet_daddr;
+	fl4->fl4_dport = inet->inet_dport;
+	fl4->fl4_sport = inet->inet_sport;
+	up->pending = AF_INET;
+
+	for (n = 0; n < vlen; n++) {
+		struct msghdr *msg = &msgs[n];
+		size_t len = msg_data_left(msg);
+		unsigned int ulen = len, tail_len = 0;
+		struct sk_buff *tail;
+
+		if (n && (!udp_batch_msg_ok(msg, len) || len > gso_size ||
+			  up->len + len > max_len))
+			break;
+
+		if (!n)
+			ulen += sizeof(struct udphdr);
+		tail = skb_peek_tail(&sk->sk_write_queue);
+		if (tail)
+			tail_len = tail->len;
+
+		up->len += ulen;
+		err = ip_append_data(sk, fl4, ip_generic_getfrag, msg, ulen,
+				     sizeof(struct udphdr), &ipc, &rt,
+				     msg->msg_flags | MSG_MORE);
+		if (err) {
+			/* Only drop this datagram, it is the caller's to retry */
+			up->len -= ulen;
+			if (tail)
+				udp_batch_trim(sk, tail, tail_len);
+			break;
+		}
+
+		/* A shorter datagram can only be the last segment */
+		if (len < gso_size) {
+			n++;
+			break;
+		}
+	}
+
+	if (n) {
+		err = udp_push_pending_frames(sk);
+		if (err)
+			n = 0;
+	} else {
+		udp_flush_pending_frames(sk);
+	}
+	release_sock(sk);
+	ip_rt_put(rt);
+
+	if (n)
+		return n;
+	/* As in udp_sendmsg() */
+	if (err == -ENOBUFS || test_bit(SOCK_NOSPACE, &sk->sk_socket->flags))
+		UDP_INC_STATS(sock_net(sk), UDP_MIB_SNDBUFERRORS, 0);
+	return err;
+}
+
+/**
+ * udp_sendmmsg - send the datagrams of a sendmmsg() call
+ * @sk: socket
+ * @msgs: messages, already checked as for sendmsg()
+ * @vlen: number of messages
+ *
+ * Same as calling udp_sendmsg() on each message in turn, stopping at the
+ * first error, except that runs of datagrams to the connected peer are
+ * sent as GSO batches.
+ *
+ * Return: the number of messages sent, or the error sending the first one.
+ */
+int udp_sendmmsg(struct sock *sk, struct msghdr *msgs, unsigned int vlen)
+{
+	unsigned int sent = 0;
+	int ret;
+
+	while (sent < vlen) {
+		ret = udp_sendmmsg_batch(sk, &msgs[sent], vlen - sent);
+		if (!ret) {
+			ret = udp_sendmsg(sk, &msgs[sent],
+					  msg_data_left(&msgs[sent]));
+			if (ret >= 0)
+				ret = 1;
+		}
+		if (ret < 0)
+			return sent ? sent : ret;
+
+		sent += ret;
+		cond_resched();
+	}
+
+	return sent;
+}
+EXPORT_SYMBOL(udp_sendmmsg);
+
 void udp_splice_eof(struct socket *sock)
 {
 	struct sock *sk = sock->sk;
@@ -2927,6 +3127,7 @@ struct proto udp_prot = {
 	.setsockopt		= udp_setsockopt,
 	.getsockopt		= udp_getsockopt,
 	.sendmsg		= udp_sendmsg,
+	.sendmmsg		= udp_sendmmsg,
 	.recvmsg		= udp_recvmsg,
 	.splice_eof		= udp_splice_eof,
 	.release_cb		= ip4_datagram_release_cb,
@@ -22,6 +22,7 @@
 #include <linux/slab.h>
 #include <linux/random.h>
 #include <linux/siphash.h>
+#include <linux/hash.h>
 #include <linux/err.h>
 #include <linux/percpu.h>
 #include <linux/moduleparam.h>
@@ -1803,6 +1804,85 @@ init_conntrack(struct net *net, struct nf_conn *tmpl,
 	return &ct->tuplehash[IP_CT_DIR_ORIGINAL];
 }
 
+/* Per-cpu direct-mapped cache of recently found conntrack entries,
+ * indexed by skb->hash, to skip hashing the tuple and walking the
+ * bucket for packets of established flows.
+ *
+ * Slots hold no reference.  Conntracks are SLAB_TYPESAFE_BY_RCU, so a
+ * slot keeps pointing to a struct nf_conn, maybe freed or reused for
+ * another flow, as long as no grace period started after the entry
+ * was freed.  The cache is wiped whenever a grace period started since
+ * the last wipe, and entries are only stored while alive, so a slot
+ * found in an unwiped cache can be dereferenced.  A candidate is then
+ * validated like in __nf_conntrack_find_get().
+ *
+ * The cache is only used with BH disabled, which keeps the users of a
+ * cpu's cache from running concurrently.
+ */
+#define NF_CT_PCPU_CACHE_BITS	8
+#define NF_CT_PCPU_CACHE_SIZE	(1U << NF_CT_PCPU_CACHE_BITS)
+
+struct nf_ct_pcpu_cache {
+	unsigned long			rcu_state;	/* at the last wipe */
+	struct nf_conntrack_tuple_hash	*slot[NF_CT_PCPU_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct nf_ct_pcpu_cache, nf_ct_pcpu_cache);
+
+/* This cpu's cache, wiped if its slots may point to freed memory */
+static struct nf_ct_pcpu_cache *nf_ct_pcpu_cache_get(void)
+{
+	struct nf_ct_pcpu_cache *cache = this_cpu_ptr(&nf_ct_pcpu_cache);
+	unsigned long state = get_state_synchronize_rcu();
+
+	if (unlikely(!same_state_synchronize_rcu(cache->rcu_state, state))) {
+		memset(cache->slot, 0, sizeof(cache->slot));
+		cache->rcu_state = state;
+	}
+
+	return cache;
+}
+
+static struct nf_conntrack_tuple_hash *
+nf_ct_pcpu_cache_lookup(const struct sk_buff *skb, struct net *net,
+			const struct nf_conntrack_zone *zone,
+			const struct nf_conntrack_tuple *tuple)
+{
+	unsigned int idx = hash_32(skb->hash, NF_CT_PCPU_CACHE_BITS);
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_conn *ct;
+
+	h = nf_ct_pcpu_cache_get()->slot[idx];
+	if (!h || !nf_ct_tuple_equal(tuple, &h->tuple))
+		goto miss;
+
+	ct = nf_ct_tuplehash_to_ctrack(h);
+	if (!refcount_inc_not_zero(&ct->ct_general.use))
+		goto miss;
+
+	/* re-check key after refcount */
+	smp_acquire__after_ctrl_dep();
+
+	if (likely(nf_ct_key_equal(h, tuple, zone, net) &&
+		   !nf_ct_is_expired(ct) && !nf_ct_is_dying(ct))) {
+		NF_CT_STAT_INC(net, cache_hit);
+		return h;
+	}
+	nf_ct_put(ct);
+miss:
+	NF_CT_STAT_INC(net, cache_miss);
+	return NULL;
+}
+
+/* Called with a reference on @h's conntrack */
+static void nf_ct_pcpu_cache_store(const struct sk_buff *skb,
+				   struct nf_conntrack_tuple_hash *h)
+{
+	unsigned int idx = hash_32(skb->hash, NF_CT_PCPU_CACHE_BITS);
+
+	nf_ct_pcpu_cache_get()->slot[idx] = h;
+}
+
 /* On success, returns 0, sets skb->_nfct | ctinfo */
 static int
 resolve_normal_ct(struct nf_conn *tmpl,
@@ -1827,6 +1907,12 @@ resolve_normal_ct(struct nf_conn *tmpl,
 	/* look for tuple match */
 	zone = nf_ct_zone_tmpl(tmpl, skb, &tmp);
 
+	if (skb->hash && in_softirq()) {
+		h = nf_ct_pcpu_cache_lookup(skb, state->net, zone, &tuple);
+		if (h)
+			goto found;
+	}
+
 	zone_id = nf_ct_zone_id(zone, IP_CT_DIR_ORIGINAL);
 	hash = hash_conntrack_raw(&tuple, zone_id, state->net);
 	h = __nf_conntrack_find_get(state->net, zone, &tuple, hash);
@@ -1847,7 +1933,10 @@ resolve_normal_ct(struct nf_conn *tmpl,
 			return 0;
 		if (IS_ERR(h))
 			return PTR_ERR(h);
+	} else if (skb->hash && in_softirq()) {
+		nf_ct_pcpu_cache_store(skb, h);
 	}
+found:
 	ct = nf_ct_tuplehash_to_ctrack(h);
 
 	/* It exists; we have (non-exclusive) reference. */
@@ -2510,7 +2510,9 @@ ctnetlink_ct_stat_cpu_fill_info(struct sk_buff *skb, u32 portid, u32 seq,
 	    nla_put_be32(skb, CTA_STATS_CLASH_RESOLVE,
 				htonl(st->clash_resolve)) ||
 	    nla_put_be32(skb, CTA_STATS_CHAIN_TOOLONG,
-			 htonl(st->chaintoolong)))
+			 htonl(st->chaintoolong)) ||
+	    nla_put_be32(skb, CTA_STATS_CACHE_HIT, htonl(st->cache_hit)) ||
+	    nla_put_be32(skb, CTA_STATS_CACHE_MISS, htonl(st->cache_miss)))
 		goto nla_put_failure;
 
 	nlmsg_end(skb, nlh);
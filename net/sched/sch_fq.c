@@ -90,7 +90,10 @@ struct fq_flow {
 	int		band;
 	struct fq_flow *next;		/* next pointer in RR lists */
 
-	struct rb_node  rate_node;	/* anchor in q->delayed tree */
+	union {
+		struct rb_node	  rate_node;	/* anchor in q->delayed tree */
+		struct hlist_node wheel_node;	/* anchor in q->wheel slots */
+	};
 	u64		time_next_packet;
 };
 
@@ -106,6 +109,31 @@ struct fq_perband_flows {
 	int		    quantum; /* based on band nr : 576KB, 192KB, 64KB */
 };
 
+/*
+ * Hierarchical timing wheel holding throttled flows, an alternative to
+ * the q->delayed rbtree when there are too many paced flows for its
+ * O(log N) insertions and rebalancing.
+ *
+ * Level 0 has one slot per tick of FQ_WHEEL_GRAN_SHIFT nanoseconds,
+ * each next level has slots FQ_WHEEL_SIZE times wider.  Flows are only
+ * released from level 0, so the pacing precision is one tick whatever
+ * the delay: when the clock crosses the start of a higher level slot,
+ * its flows are cascaded down using their exact time_next_packet.
+ */
+#define FQ_WHEEL_BITS		6
+#define FQ_WHEEL_SIZE		(1U << FQ_WHEEL_BITS)
+#define FQ_WHEEL_MASK		(FQ_WHEEL_SIZE - 1)
+#define FQ_WHEEL_LEVELS		4
+#define FQ_WHEEL_GRAN_SHIFT	10	/* 1.024 usec ticks, ~17 sec range */
+#define FQ_WHEEL_LVL_SHIFT(lvl)	((lvl) * FQ_WHEEL_BITS)
+#define FQ_WHEEL_RANGE		(1ULL << FQ_WHEEL_LVL_SHIFT(FQ_WHEEL_LEVELS))
+
+struct fq_wheel {
+	u64			clk;	/* next tick to process */
+	u64			pending[FQ_WHEEL_LEVELS];
+	struct hlist_head	slots[FQ_WHEEL_LEVELS][FQ_WHEEL_SIZE];
+};
+
 struct fq_sched_data {
 /* Read mostly cache line */
 
@@ -133,6 +161,7 @@ struct fq_sched_data {
 
 	struct fq_flow	internal;	/* fastpath queue. */
 	struct rb_root	delayed;	/* for rate limited flows */
+	struct fq_wheel	*wheel;		/* replaces delayed if not NULL */
 	u64		time_next_delayed_flow;
 	unsigned long	unthrottle_latency_ns;
 
@@ -209,12 +238,16 @@ static void fq_flow_add_tail(struct fq_sched_data *q, struct fq_flow *flow,
 
 static void fq_flow_unset_throttled(struct fq_sched_data *q, struct fq_flow *f)
 {
-	rb_erase(&f->rate_node, &q->delayed);
+	/* A stale wheel pending bit only causes a spurious wakeup */
+	if (q->wheel)
+		hlist_del(&f->wheel_node);
+	else
+		rb_erase(&f->rate_node, &q->delayed);
 	q->throttled_flows--;
 	fq_flow_add_tail(q, f, OLD_FLOW);
 }
 
-static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
+static void fq_delayed_insert(struct fq_sched_data *q, struct fq_flow *f)
 {
 	struct rb_node **p = &q->delayed.rb_node, *parent = NULL;
 
@@ -230,6 +263,154 @@ static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
 	}
 	rb_link_node(&f->rate_node, parent, p);
 	rb_insert_color(&f->rate_node, &q->delayed);
+}
+
+static void fq_wheel_insert(struct fq_wheel *w, struct fq_flow *f)
+{
+	u64 expires = f->time_next_packet >> FQ_WHEEL_GRAN_SHIFT;
+	unsigned int lvl, idx;
+	u64 delta;
+
+	if (expires < w->clk)
+		expires = w->clk;
+	delta = expires - w->clk;
+	if (unlikely(delta >= FQ_WHEEL_RANGE)) {
+		/* parked in the last level, cascaded again from there */
+		delta = FQ_WHEEL_RANGE - 1;
+		expires = w->clk + delta;
+	}
+
+	/* Pick the lowest level whose slot for @expires is less than one
+	 * full turn ahead of the clock.
+	 */
+	for (lvl = 0; lvl < FQ_WHEEL_LEVELS - 1; lvl++) {
+		if (delta < (1ULL << FQ_WHEEL_LVL_SHIFT(lvl + 1)))
+			break;
+	}
+	idx = (expires >> FQ_WHEEL_LVL_SHIFT(lvl)) & FQ_WHEEL_MASK;
+	hlist_add_head(&f->wheel_node, &w->slots[lvl][idx]);
+	w->pending[lvl] |= BIT_ULL(idx);
+}
+
+/* Move the flows of every higher level slot starting at w->clk down */
+static void fq_wheel_cascade(struct fq_wheel *w)
+{
+	unsigned int lvl;
+
+	/* Highest level first, its flows may land in a lower level slot
+	 * starting at the same tick.
+	 */
+	for (lvl = FQ_WHEEL_LEVELS - 1; lvl > 0; lvl--) {
+		unsigned int shift = FQ_WHEEL_LVL_SHIFT(lvl);
+		unsigned int idx = (w->clk >> shift) & FQ_WHEEL_MASK;
+		struct hlist_node *tmp;
+		struct fq_flow *f;
+		HLIST_HEAD(list);
+
+		if (w->clk & ((1ULL << shift) - 1))
+			continue;
+		if (!(w->pending[lvl] & BIT_ULL(idx)))
+			continue;
+
+		hlist_move_list(&w->slots[lvl][idx], &list);
+		w->pending[lvl] &= ~BIT_ULL(idx);
+		hlist_for_each_entry_safe(f, tmp, &list, wheel_node)
+			fq_wheel_insert(w, f);
+	}
+}
+
+/* Earliest tick at or after w->clk at which a level 0 slot expires or a
+ * higher level slot cascades, ~0ULL if the wheel is empty.
+ */
+static u64 fq_wheel_next_tick(const struct fq_wheel *w)
+{
+	unsigned int idx = w->clk & FQ_WHEEL_MASK;
+	u64 next = ~0ULL;
+	unsigned int lvl;
+
+	if (w->pending[0]) {
+		u64 bits = w->pending[0] >> idx;
+
+		if (bits)
+			return w->clk + __ffs64(bits);
+		next = (w->clk & ~(u64)FQ_WHEEL_MASK) + FQ_WHEEL_SIZE +
+		       __ffs64(w->pending[0]);
+	}
+
+	for (lvl = 1; lvl < FQ_WHEEL_LEVELS; lvl++) {
+		unsigned int shift = FQ_WHEEL_LVL_SHIFT(lvl);
+		u64 block = w->clk >> shift;
+		u64 bits, tick;
+
+		if (!w->pending[lvl])
+			continue;
+
+		/* The slot of the current block cascades at its start,
+		 * which may still be ahead if w->clk sits exactly on it.
+		 */
+		if (!(w->clk & ((1ULL << shift) - 1)) &&
+		    (w->pending[lvl] & BIT_ULL(block & FQ_WHEEL_MASK)))
+			return w->clk;
+
+		bits = ror64(w->pending[lvl], (block + 1) & FQ_WHEEL_MASK);
+		tick = (block + 1 + __ffs64(bits)) << shift;
+		next = min(next, tick);
+	}
+	return next;
+}
+
+static void fq_wheel_expire(struct fq_sched_data *q, unsigned int idx)
+{
+	struct fq_wheel *w = q->wheel;
+	struct hlist_node *tmp;
+	struct fq_flow *f;
+
+	hlist_for_each_entry_safe(f, tmp, &w->slots[0][idx], wheel_node) {
+		hlist_del(&f->wheel_node);
+		q->throttled_flows--;
+		fq_flow_add_tail(q, f, OLD_FLOW);
+	}
+	w->pending[0] &= ~BIT_ULL(idx);
+}
+
+/* Release every throttled flow due at or before @now, and return the
+ * time of the next wheel event (~0ULL if none). Cascade boundaries count
+ * as events, so the caller may be woken up early without anything to send.
+ */
+static u64 fq_wheel_advance(struct fq_sched_data *q, u64 now)
+{
+	u64 now_tick = now >> FQ_WHEEL_GRAN_SHIFT;
+	struct fq_wheel *w = q->wheel;
+	u64 next;
+
+	while (w->clk <= now_tick) {
+		unsigned int idx = w->clk & FQ_WHEEL_MASK;
+
+		if (!idx)
+			fq_wheel_cascade(w);
+		if (w->pending[0] & BIT_ULL(idx))
+			fq_wheel_expire(q, idx);
+
+		w->clk++;
+		next = fq_wheel_next_tick(w);
+		if (next > now_tick) {
+			/* Nothing due in between, skip the empty ticks */
+			w->clk = max(w->clk, now_tick + 1);
+			break;
+		}
+		w->clk = next;
+	}
+
+	next = fq_wheel_next_tick(w);
+	return next == ~0ULL ? ~0ULL : next << FQ_WHEEL_GRAN_SHIFT;
+}
+
+static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
+{
+	if (q->wheel)
+		fq_wheel_insert(q->wheel, f);
+	else
+		fq_delayed_insert(q, f);
 	q->throttled_flows++;
 	q->stat_throttled++;
 
@@ -603,6 +784,11 @@ static void fq_check_throttled(struct fq_sched_data *q, u64 now)
 	q->unthrottle_latency_ns -= q->unthrottle_latency_ns >> 3;
 	q->unthrottle_latency_ns += sample >> 3;
 
+	if (q->wheel) {
+		q->time_next_delayed_flow = fq_wheel_advance(q, now);
+		return;
+	}
+
 	q->time_next_delayed_flow = ~0ULL;
 	while ((p = rb_first(&q->delayed)) != NULL) {
 		struct fq_flow *f = rb_entry(p, struct fq_flow, rate_node);
@@ -807,11 +993,65 @@ static void fq_reset(struct Qdisc *sch)
 		q->band_flows[idx].old_flows.first = NULL;
 	}
 	q->delayed		= RB_ROOT;
+	if (q->wheel) {
+		memset(q->wheel->pending, 0, sizeof(q->wheel->pending));
+		memset(q->wheel->slots, 0, sizeof(q->wheel->slots));
+	}
 	q->flows		= 0;
 	q->inactive_flows	= 0;
 	q->throttled_flows	= 0;
 }
 
+static struct fq_wheel *fq_wheel_alloc(struct Qdisc *sch)
+{
+	struct fq_wheel *w;
+
+	w = kvzalloc_node(sizeof(*w), GFP_KERNEL | __GFP_RETRY_MAYFAIL,
+			  netdev_queue_numa_node_read(sch->dev_queue));
+	if (w)
+		w->clk = ktime_get_ns() >> FQ_WHEEL_GRAN_SHIFT;
+	return w;
+}
+
+/* Move throttled flows between q->delayed and a timing wheel.
+ * Called with qdisc lock held, returns the wheel no longer in use.
+ */
+static struct fq_wheel *fq_wheel_switch(struct fq_sched_data *q,
+					struct fq_wheel *nw)
+{
+	struct fq_wheel *ow = q->wheel;
+	struct rb_node *p;
+
+	if (ow) {
+		unsigned int lvl, idx;
+
+		for (lvl = 0; lvl < FQ_WHEEL_LEVELS; lvl++) {
+			for (idx = 0; idx < FQ_WHEEL_SIZE; idx++) {
+				struct hlist_node *tmp;
+				struct fq_flow *f;
+
+				hlist_for_each_entry_safe(f, tmp,
+							  &ow->slots[lvl][idx],
+							  wheel_node) {
+					hlist_del(&f->wheel_node);
+					fq_delayed_insert(q, f);
+				}
+			}
+		}
+	}
+	if (nw) {
+		while ((p = rb_first(&q->delayed)) != NULL) {
+			struct fq_flow *f = rb_entry(p, struct fq_flow,
+						     rate_node);
+
+			rb_erase(p, &q->delayed);
+			fq_wheel_insert(nw, f);
+		}
+	}
+	q->wheel = nw;
+	return ow;
+}
+
 static void fq_rehash(struct fq_sched_data *q,
 		      struct rb_root *old_array, u32 old_log,
 		      struct rb_root *new_array, u32 new_log)
@@ -921,6 +1161,7 @@ static const struct nla_policy fq_policy[TCA_FQ_MAX + 1] = {
 	[TCA_FQ_HORIZON_DROP]		= { .type = NLA_U8 },
 	[TCA_FQ_PRIOMAP]		= NLA_POLICY_EXACT_LEN(sizeof(struct tc_prio_qopt)),
 	[TCA_FQ_WEIGHTS]		= NLA_POLICY_EXACT_LEN(FQ_BANDS * sizeof(s32)),
+	[TCA_FQ_PACING_WHEEL]		= NLA_POLICY_MAX(NLA_U8, 1),
 };
 
 /* compress a u8 array with all elems <= 3 to an array of 2-bit fields */
@@ -988,6 +1229,7 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 		     struct netlink_ext_ack *extack)
 {
 	struct fq_sched_data *q = qdisc_priv(sch);
+	struct fq_wheel *wheel = NULL, *old_wheel = NULL;
 	struct nlattr *tb[TCA_FQ_MAX + 1];
 	int err, drop_count = 0;
 	unsigned drop_len = 0;
@@ -998,6 +1240,13 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	if (err < 0)
 		return err;
 
+	if (tb[TCA_FQ_PACING_WHEEL] && nla_get_u8(tb[TCA_FQ_PACING_WHEEL]) &&
+	    !q->wheel) {
+		wheel = fq_wheel_alloc(sch);
+		if (!wheel)
+			return -ENOMEM;
+	}
+
 	sch_tree_lock(sch);
 
 	fq_log = q->fq_trees_log;
@@ -1081,6 +1330,14 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	if (tb[TCA_FQ_HORIZON_DROP])
 		q->horizon_drop = nla_get_u8(tb[TCA_FQ_HORIZON_DROP]);
 
+	if (!err && tb[TCA_FQ_PACING_WHEEL]) {
+		if (wheel)
+			old_wheel = fq_wheel_switch(q, wheel);
+		else if (!nla_get_u8(tb[TCA_FQ_PACING_WHEEL]) && q->wheel)
+			old_wheel = fq_wheel_switch(q, NULL);
+		wheel = NULL;
+	}
+
 	if (!err) {
 
 		sch_tree_unlock(sch);
@@ -1099,6 +1356,8 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	qdisc_tree_reduce_backlog(sch, drop_count, drop_len);
 
 	sch_tree_unlock(sch);
+	kvfree(old_wheel);
+	kvfree(wheel);
 	return err;
 }
 
@@ -1108,6 +1367,7 @@ static void fq_destroy(struct Qdisc *sch)
 
 	fq_reset(sch);
 	fq_free(q->fq_root);
+	kvfree(q->wheel);
 	qdisc_watchdog_cancel(&q->watchdog);
 }
 
@@ -1133,6 +1393,7 @@ static int fq_init(struct Qdisc *sch, struct nlattr *opt,
 	q->band_flows[1].quantum = 3 << 16;
 	q->band_flows[2].quantum = 1 << 16;
 	q->delayed		= RB_ROOT;
+	q->wheel		= NULL;
 	q->fq_root		= NULL;
 	q->fq_trees_log		= ilog2(1024);
 	q->orphan_mask		= 1024 - 1;
@@ -1193,7 +1454,8 @@ static int fq_dump(struct Qdisc *sch, struct sk_buff *skb)
 	    nla_put_u32(skb, TCA_FQ_BUCKETS_LOG, q->fq_trees_log) ||
 	    nla_put_u32(skb, TCA_FQ_TIMER_SLACK, q->timer_slack) ||
 	    nla_put_u32(skb, TCA_FQ_HORIZON, (u32)horizon) ||
-	    nla_put_u8(skb, TCA_FQ_HORIZON_DROP, q->horizon_drop))
+	    nla_put_u8(skb, TCA_FQ_HORIZON_DROP, q->horizon_drop) ||
+	    nla_put_u8(skb, TCA_FQ_PACING_WHEEL, !!q->wheel))
 		goto nla_put_failure;
 
 	fq_prio2band_decompress_crumb(q->prio2band, prio.priomap);
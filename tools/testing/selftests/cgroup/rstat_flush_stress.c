@@ -0,0 +1,360 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Stress the flushing of the cgroup recursive stats.
+ *
+ * Create a number of subtrees holding a number of cgroups each, and keep one
+ * busy task per CPU hopping between the cgroups so that their stats are
+ * updated on every CPU. Meanwhile, one thread per CPU reads cpu.stat of all
+ * the cgroups in a loop, as a monitoring agent would, each thread starting
+ * from a different subtree. Fail if the usage of a cgroup ever goes
+ * backwards or if, once the busy tasks are gone, the usage of a subtree root
+ * is below the sum of the usage of its children. The number of reads per
+ * second is reported, with strict flushes and with
+ * cgroup.rstat_max_staleness_ms set.
+ */
+
+#define _GNU_SOURCE
+
+#include <linux/limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../kselftest.h"
+#include "cgroup_util.h"
+
+#define NR_SUBTREES	8
+#define NR_CGROUPS	64
+#define NR_READS	(NR_SUBTREES * NR_CGROUPS)
+#define DURATION	5
+#define STALENESS_MS	"100"
+
+#define STALENESS_PARAM	"/sys/module/cgroup/parameters/rstat_max_staleness_ms"
+
+struct stress {
+	char *subtrees[NR_SUBTREES];
+	char *cgroups[NR_SUBTREES][NR_CGROUPS];
+	volatile int stop;
+};
+
+struct reader {
+	pthread_t thread;
+	struct stress *stress;
+	int id;
+	unsigned long reads;
+	int failed;
+	long usage[NR_READS];
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stress_destroy(struct stress *st)
+{
+	int s, c;
+
+	for (s = 0; s < NR_SUBTREES; s++) {
+		for (c = 0; c < NR_CGROUPS; c++) {
+			if (st->cgroups[s][c])
+				cg_destroy(st->cgroups[s][c]);
+			free(st->cgroups[s][c]);
+		}
+		if (st->subtrees[s])
+			cg_destroy(st->subtrees[s]);
+		free(st->subtrees[s]);
+	}
+}
+
+static int stress_create(struct stress *st, const char *parent)
+{
+	int s, c;
+
+	for (s = 0; s < NR_SUBTREES; s++) {
+		st->subtrees[s] = cg_name_indexed(parent, "rstat_subtree", s);
+		if (!st->subtrees[s] || cg_create(st->subtrees[s]))
+			return -1;
+
+		for (c = 0; c < NR_CGROUPS; c++) {
+			st->cgroups[s][c] = cg_name_indexed(st->subtrees[s],
+							    "rstat_cg", c);
+			if (!st->cgroups[s][c] || cg_create(st->cgroups[s][c]))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Burn CPU time in every cgroup in turn, until killed */
+static void hop(struct stress *st, int cpu)
+{
+	int i = cpu;
+
+	for (;;) {
+		unsigned long long end;
+
+		if (cg_enter_current(st->cgroups[i % NR_SUBTREES]
+						[(i / NR_SUBTREES) % NR_CGROUPS]))
+			_exit(1);
+
+		end = now_ns() + 100000;
+		while (now_ns() < end)
+			;
+		i++;
+	}
+}
+
+static void *reader_fn(void *arg)
+{
+	struct reader *r = arg;
+	struct stress *st = r->stress;
+	int i;
+
+	while (!st->stop) {
+		for (i = 0; i < NR_READS && !st->stop; i++) {
+			/* Start from a different subtree in every reader */
+			int idx = (i + r->id * NR_CGROUPS) % NR_READS;
+			const char *cg = st->cgroups[idx / NR_CGROUPS]
+						    [idx % NR_CGROUPS];
+			long usage;
+
+			usage = cg_read_key_long(cg, "cpu.stat", "usage_usec");
+			if (usage < 0) {
+				ksft_print_msg("reading %s/cpu.stat failed\n", cg);
+				r->failed = 1;
+				return NULL;
+			}
+			if (usage < r->usage[idx]) {
+				ksft_print_msg("%s: usage went from %ld to %ld\n",
+					       cg, r->usage[idx], usage);
+				r->failed = 1;
+			}
+			r->usage[idx] = usage;
+			r->reads++;
+		}
+	}
+
+	return NULL;
+}
+
+/* Check that the usage of every subtree root covers its children */
+static int check_subtrees(struct stress *st)
+{
+	int s, c, ret = 0;
+
+	for (s = 0; s < NR_SUBTREES; s++) {
+		long usage, sum = 0;
+
+		for (c = 0; c < NR_CGROUPS; c++) {
+			usage = cg_read_key_long(st->cgroups[s][c], "cpu.stat",
+						 "usage_usec");
+			if (usage < 0)
+				return -1;
+			sum += usage;
+		}
+
+		usage = cg_read_key_long(st->subtrees[s], "cpu.stat",
+					 "usage_usec");
+		if (usage < 0)
+			return -1;
+		if (usage < sum) {
+			ksft_print_msg("%s: usage %ld below the sum %ld of its children\n",
+				       st->subtrees[s], usage, sum);
+			ret = -1;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Read the stats of all the cgroups of @parent's subtrees from one thread
+ * per CPU, while one task per CPU updates them.
+ */
+static int run_stress(const char *parent)
+{
+	int nr_cpus = get_nprocs(), started, failed = 0, i, ret = KSFT_FAIL;
+	struct reader *readers = NULL;
+	unsigned long reads = 0;
+	pid_t *hoppers = NULL;
+	char strict[] = "0";
+	struct stress *st;
+
+	st = calloc(1, sizeof(*st));
+	if (!st)
+		return KSFT_FAIL;
+
+	if (stress_create(st, parent))
+		goto cleanup;
+
+	hoppers = calloc(nr_cpus, sizeof(*hoppers));
+	readers = calloc(nr_cpus, sizeof(*readers));
+	if (!hoppers || !readers)
+		goto cleanup;
+
+	for (i = 0; i < nr_cpus; i++) {
+		hoppers[i] = fork();
+		if (hoppers[i] < 0)
+			goto cleanup;
+		if (!hoppers[i])
+			hop(st, i);
+	}
+
+	for (started = 0; started < nr_cpus; started++) {
+		readers[started].stress = st;
+		readers[started].id = started;
+		if (pthread_create(&readers[started].thread, NULL, reader_fn,
+				   &readers[started]))
+			break;
+	}
+
+	if (started == nr_cpus)
+		sleep(DURATION);
+	else
+		failed = 1;
+	st->stop = 1;
+
+	for (i = 0; i < started; i++) {
+		pthread_join(readers[i].thread, NULL);
+		reads += readers[i].reads;
+		failed |= readers[i].failed;
+	}
+	if (failed)
+		goto cleanup;
+
+	for (i = 0; i < nr_cpus; i++) {
+		kill(hoppers[i], SIGKILL);
+		waitpid(hoppers[i], NULL, 0);
+		hoppers[i] = 0;
+	}
+
+	/* Strict flushes for the final check */
+	if (!access(STALENESS_PARAM, F_OK) &&
+	    write_text(STALENESS_PARAM, strict, strlen(strict)) < 0)
+		goto cleanup;
+	if (check_subtrees(st))
+		goto cleanup;
+
+	ksft_print_msg("%d subtrees of %d cgroups, %d readers: %lu reads/s\n",
+		       NR_SUBTREES, NR_CGROUPS, nr_cpus, reads / DURATION);
+	ret = KSFT_PASS;
+
+cleanup:
+	for (i = 0; hoppers && i < nr_cpus; i++) {
+		if (hoppers[i] <= 0)
+			continue;
+		kill(hoppers[i], SIGKILL);
+		waitpid(hoppers[i], NULL, 0);
+	}
+	stress_destroy(st);
+	free(readers);
+	free(hoppers);
+	free(st);
+
+	return ret;
+}
+
+/*
+ * Run the stress with cgroup.rstat_max_staleness_ms set to @staleness, if
+ * the kernel has it. Without it, flushes are always strict.
+ */
+static int test_rstat_flush(const char *root, char *staleness)
+{
+	int ret = KSFT_FAIL;
+	char old[32] = "";
+	char *parent;
+
+	if (read_text(STALENESS_PARAM, old, sizeof(old)) < 0) {
+		if (strcmp(staleness, "0"))
+			return KSFT_SKIP;
+	} else if (write_text(STALENESS_PARAM, staleness,
+			      strlen(staleness)) < 0) {
+		return KSFT_FAIL;
+	}
+
+	parent = cg_name(root, "rstat_flush_test");
+	if (!parent || cg_create(parent))
+		goto cleanup;
+
+	ret = run_stress(parent);
+
+cleanup:
+	if (parent)
+		cg_destroy(parent);
+	free(parent);
+	if (old[0])
+		write_text(STALENESS_PARAM, old, strlen(old));
+	return ret;
+}
+
+/*
+ * Readers of cpu.stat get up to date stats while the cgroups of many
+ * disjoint subtrees are flushed in parallel.
+ */
+static int test_rstat_flush_strict(const char *root)
+{
+	char staleness[] = "0";
+
+	return test_rstat_flush(root, staleness);
+}
+
+/*
+ * Same with cgroup.rstat_max_staleness_ms set: readers may get stale stats,
+ * but still never see them go backwards, and strict flushes see them all.
+ */
+static int test_rstat_flush_stale(const char *root)
+{
+	char staleness[] = STALENESS_MS;
+
+	return test_rstat_flush(root, staleness);
+}
+
+#define T(x) { x, #x }
+struct rstat_test {
+	int (*fn)(const char *root);
+	const char *name;
+} tests[] = {
+	T(test_rstat_flush_strict),
+	T(test_rstat_flush_stale),
+};
+#undef T
+
+int main(int argc, char *argv[])
+{
+	char root[PATH_MAX];
+	int i, ret = EXIT_SUCCESS;
+
+	ksft_print_header();
+	ksft_set_plan(ARRAY_SIZE(tests));
+
+	if (cg_find_unified_root(root, sizeof(root), NULL))
+		ksft_exit_skip("cgroup v2 isn't mounted\n");
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		switch (tests[i].fn(root)) {
+		case KSFT_PASS:
+			ksft_test_result_pass("%s\n", tests[i].name);
+			break;
+		case KSFT_SKIP:
+			ksft_test_result_skip("%s\n", tests[i].name);
+			break;
+		default:
+			ret = EXIT_FAILURE;
+			ksft_test_result_fail("%s\n", tests[i].name);
+			break;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test CLONE_SELECT_FILES: the child starts with a new file table holding
+ * only the file descriptors of the parent passed in clone_args.fds.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define KSFT_PASS	0
+#define KSFT_FAIL	1
+#define KSFT_SKIP	4
+
+#ifndef __NR_clone3
+#define __NR_clone3 435
+#endif
+
+#ifndef CLONE_SELECT_FILES
+#define CLONE_SELECT_FILES 0x400000000ULL
+#endif
+
+/* The parent has that many files open */
+#define NR_FILES	1000
+
+struct __clone_args {
+	uint64_t flags;
+	uint64_t pidfd;
+	uint64_t child_tid;
+	uint64_t parent_tid;
+	uint64_t exit_signal;
+	uint64_t stack;
+	uint64_t stack_size;
+	uint64_t tls;
+	uint64_t set_tid;
+	uint64_t set_tid_size;
+	uint64_t cgroup;
+	uint64_t fds;
+	uint64_t fds_size;
+};
+
+static int fd_flags(int fd)
+{
+	return fcntl(fd, F_GETFD);
+}
+
+/*
+ * Clone a child with CLONE_SELECT_FILES and @flags, selecting @fds. The child
+ * checks that exactly @fds are open, that @cloexec is close-on-exec and that
+ * the other ones are not. Returns the status of the child, or -errno if
+ * clone3() failed.
+ */
+static int select_files(uint64_t flags, int *fds, int nr_fds, int cloexec,
+			int closed)
+{
+	struct __clone_args args = {
+		.flags		= CLONE_SELECT_FILES | flags,
+		.exit_signal	= SIGCHLD,
+		.fds		= (uintptr_t)fds,
+		.fds_size	= nr_fds,
+	};
+	int status, i;
+	pid_t pid;
+
+	pid = syscall(__NR_clone3, &args, sizeof(args));
+	if (pid < 0)
+		return -errno;
+
+	if (!pid) {
+		for (i = 0; i < nr_fds; i++) {
+			int ret = fd_flags(fds[i]);
+
+			if (ret < 0)
+				_exit(1);
+			if (!!(ret & FD_CLOEXEC) != (fds[i] == cloexec))
+				_exit(2);
+		}
+		if (fd_flags(closed) >= 0 || errno != EBADF)
+			_exit(3);
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+		return -ECHILD;
+
+	return WEXITSTATUS(status);
+}
+
+int main(void)
+{
+	int files[NR_FILES], fds[4];
+	int i, ret, failed = 0;
+
+	for (i = 0; i < NR_FILES; i++) {
+		files[i] = open("/dev/null", O_RDONLY);
+		if (files[i] < 0) {
+			fprintf(stderr, "SKIP: can't open %d files\n", NR_FILES);
+			return KSFT_SKIP;
+		}
+	}
+	fcntl(files[NR_FILES / 2], F_SETFD, FD_CLOEXEC);
+
+	fds[0] = files[1];
+	fds[1] = files[NR_FILES - 1];
+	fds[2] = files[NR_FILES / 2];
+	fds[3] = fds[1];
+	ret = select_files(0, fds, 4, files[NR_FILES / 2], files[0]);
+	if (ret == -EINVAL || ret == -E2BIG) {
+		fprintf(stderr, "SKIP: CLONE_SELECT_FILES not supported\n");
+		return KSFT_SKIP;
+	}
+	printf("%s: selected files (%d)\n", ret ? "FAIL" : "PASS", ret);
+	failed |= ret;
+
+	ret = select_files(0, NULL, 0, -1, 0);
+	printf("%s: empty file table (%d)\n", ret ? "FAIL" : "PASS", ret);
+	failed |= ret;
+
+	close(files[0]);
+	fds[0] = files[0];
+	ret = select_files(0, fds, 1, -1, 0);
+	printf("%s: closed file rejected (%d)\n",
+	       ret == -EBADF ? "PASS" : "FAIL", ret);
+	failed |= ret != -EBADF;
+
+	ret = select_files(CLONE_FILES, NULL, 0, -1, 0);
+	printf("%s: CLONE_FILES rejected (%d)\n",
+	       ret == -EINVAL ? "PASS" : "FAIL", ret);
+	failed |= ret != -EINVAL;
+
+	return failed ? KSFT_FAIL : KSFT_PASS;
+}
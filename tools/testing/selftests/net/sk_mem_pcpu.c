@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Stress protocol memory accounting (tcp_memory_allocated) from many
+ * cpus at once: every thread owns a loopback TCP connection and sends
+ * small messages on it, so that receive queues are made of many small
+ * skbs, each one charged and uncharged separately.
+ *
+ * Each thread is pinned to one of the cpus the test is allowed to run
+ * on. The aggregate number of messages per second is reported; compare
+ * runs with different net.core.mem_pcpu_rsv values to see the cost of
+ * the shared counter.
+ */
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS	1024
+
+static int cfg_duration = 5;
+static int cfg_msg_len = 64;
+static int cfg_threads;
+static int cfg_rcvlowat_msgs = 64;
+
+static volatile bool stop;
+
+struct worker {
+	pthread_t	tx_thread;
+	pthread_t	rx_thread;
+	int		cpu;
+	int		tx_fd;
+	int		rx_fd;
+	unsigned long	msgs;
+};
+
+static struct worker workers[MAX_THREADS];
+
+static void pin(int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		error(1, errno, "sched_setaffinity %d", cpu);
+}
+
+static void connect_pair(struct worker *w)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	int lfd, one = 1;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		error(1, errno, "socket");
+	if (bind(lfd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "bind");
+	if (listen(lfd, 1))
+		error(1, errno, "listen");
+	if (getsockname(lfd, (void *)&addr, &len))
+		error(1, errno, "getsockname");
+
+	w->tx_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (w->tx_fd < 0)
+		error(1, errno, "socket");
+	if (setsockopt(w->tx_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)))
+		error(1, errno, "setsockopt TCP_NODELAY");
+	if (connect(w->tx_fd, (void *)&addr, sizeof(addr)))
+		error(1, errno, "connect");
+
+	w->rx_fd = accept(lfd, NULL, NULL);
+	if (w->rx_fd < 0)
+		error(1, errno, "accept");
+	close(lfd);
+}
+
+static void *tx_loop(void *arg)
+{
+	struct worker *w = arg;
+	char buf[cfg_msg_len];
+
+	pin(w->cpu);
+	memset(buf, 'a', sizeof(buf));
+
+	while (!stop) {
+		if (send(w->tx_fd, buf, sizeof(buf), 0) < 0) {
+			if (errno == EINTR)
+				continue;
+			error(1, errno, "send");
+		}
+		w->msgs++;
+	}
+	shutdown(w->tx_fd, SHUT_WR);
+	return NULL;
+}
+
+static void *rx_loop(void *arg)
+{
+	struct worker *w = arg;
+	int lowat = cfg_msg_len * cfg_rcvlowat_msgs;
+	char buf[1 << 16];
+	ssize_t ret;
+
+	pin(w->cpu);
+
+	/* Let small skbs pile up in the receive queue between reads */
+	if (setsockopt(w->rx_fd, SOL_SOCKET, SO_RCVLOWAT, &lowat,
+		       sizeof(lowat)))
+		error(1, errno, "setsockopt SO_RCVLOWAT");
+
+	do {
+		ret = recv(w->rx_fd, buf, sizeof(buf), 0);
+		if (ret < 0 && errno != EINTR)
+			error(1, errno, "recv");
+	} while (ret);
+
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-d seconds] [-l msg_len] [-t threads] "
+		"[-w msgs per read]\n", prog);
+	exit(1);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "d:l:t:w:")) != -1) {
+		switch (c) {
+		case 'd':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			cfg_msg_len = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			cfg_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			cfg_rcvlowat_msgs = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (cfg_threads > MAX_THREADS)
+		cfg_threads = MAX_THREADS;
+	if (cfg_duration <= 0 || cfg_msg_len <= 0 || cfg_msg_len > 1 << 16 ||
+	    cfg_rcvlowat_msgs <= 0)
+		usage(argv[0]);
+}
+
+int main(int argc, char **argv)
+{
+	int cpus[MAX_THREADS], nr_cpus = 0;
+	unsigned long total = 0;
+	cpu_set_t mask;
+	int i;
+
+	parse_opts(argc, argv);
+
+	/* The allowed cpus need not be contiguous nor start at 0 */
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		error(1, errno, "sched_getaffinity");
+	for (i = 0; i < CPU_SETSIZE && nr_cpus < MAX_THREADS; i++)
+		if (CPU_ISSET(i, &mask))
+			cpus[nr_cpus++] = i;
+	if (!cfg_threads)
+		cfg_threads = nr_cpus;
+
+	for (i = 0; i < cfg_threads; i++) {
+		workers[i].cpu = cpus[i % nr_cpus];
+		connect_pair(&workers[i]);
+	}
+
+	for (i = 0; i < cfg_threads; i++) {
+		if (pthread_create(&workers[i].rx_thread, NULL, rx_loop,
+				   &workers[i]))
+			error(1, 0, "pthread_create");
+		if (pthread_create(&workers[i].tx_thread, NULL, tx_loop,
+				   &workers[i]))
+			error(1, 0, "pthread_create");
+	}
+
+	sleep(cfg_duration);
+	stop = true;
+
+	for (i = 0; i < cfg_threads; i++) {
+		pthread_join(workers[i].tx_thread, NULL);
+		pthread_join(workers[i].rx_thread, NULL);
+		close(workers[i].tx_fd);
+		close(workers[i].rx_fd);
+		total += workers[i].msgs;
+	}
+
+	printf("threads %d msg_len %d: %lu msgs/s\n",
+	       cfg_threads, cfg_msg_len, total / cfg_duration);
+	return 0;
+}
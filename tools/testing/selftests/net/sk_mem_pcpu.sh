@@ -0,0 +1,45 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Run the sk_mem_pcpu benchmark with several net.core.mem_pcpu_rsv
+# values: 1 page disables the per-cpu batching of protocol memory
+# accounting, larger values reduce the traffic on tcp_memory_allocated.
+# A benchmark without a verdict, so it is not part of the default run.
+
+readonly NETNS="ns-$(mktemp -u XXXXXX)"
+readonly KSFT_SKIP=4
+readonly SYSCTL=/proc/sys/net/core/mem_pcpu_rsv
+
+DURATION=${DURATION:-5}
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "SKIP: need root privileges"
+	exit $KSFT_SKIP
+fi
+
+if [ ! -w "$SYSCTL" ]; then
+	echo "SKIP: $SYSCTL not available"
+	exit $KSFT_SKIP
+fi
+
+orig_rsv=$(cat "$SYSCTL")
+
+cleanup() {
+	echo "$orig_rsv" > "$SYSCTL"
+	ip netns del "${NETNS}" 2>/dev/null
+}
+trap cleanup EXIT
+
+ip netns add "${NETNS}"
+ip -netns "${NETNS}" link set lo up
+
+ret=0
+for rsv in 1 "$orig_rsv" $((orig_rsv * 16)); do
+	echo "$rsv" > "$SYSCTL"
+	echo -n "mem_pcpu_rsv $rsv: "
+	if ! ip netns exec "${NETNS}" ./sk_mem_pcpu -d "$DURATION" "$@"; then
+		ret=1
+	fi
+done
+
+exit $ret
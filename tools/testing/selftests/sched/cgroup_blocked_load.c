@@ -0,0 +1,384 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Measure the cost of the blocked load of many cgroups on an idle CPU.
+ *
+ * Create a number of cpu cgroups (2000 by default) and leave some blocked
+ * load in each of them on every CPU by running a short busy loop in every
+ * cgroup, on every CPU. Then ping-pong a byte between two tasks on two CPUs
+ * through pipes: each CPU goes idle between messages, which makes it update
+ * the blocked load of all the cgroups that have some. Measure the number of
+ * round trips per second with the LAZY_BLOCKED_DECAY sched feature off, then
+ * on, and fail if it is lower with the feature on, beyond some noise.
+ *
+ * Needs root, debugfs, two CPUs, and a cgroup v2 hierarchy with the cpu
+ * controller available. The cgroups are removed and the feature restored
+ * however the test ends.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KSFT_PASS	0
+#define KSFT_FAIL	1
+#define KSFT_SKIP	4
+
+#define FEATURES	"/sys/kernel/debug/sched/features"
+#define FEATURE		"LAZY_BLOCKED_DECAY"
+
+/* Round trips with the feature on, in percent of those with it off */
+#define MIN_RATIO	90
+
+static const char *cfg_root = "/sys/fs/cgroup";
+static int cfg_cgroups = 2000;
+static int cfg_duration = 1;
+static int cfg_burn_us = 100;
+
+static char base[256], ctl[300];
+static int nr_created;
+static int was_on = -1;
+static pid_t main_pid;
+static cpu_set_t cpus;
+
+static int pin(int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/* The @n-th CPU we may run on */
+static int nth_cpu(int n)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &cpus) && !n--)
+			return cpu;
+	}
+
+	return -1;
+}
+
+static int write_file(const char *path, const char *buf)
+{
+	int fd, ret;
+
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, buf, strlen(buf));
+	close(fd);
+
+	return ret < 0 ? -1 : 0;
+}
+
+/* Whether FEATURE is on, -1 if it can't be read */
+static int read_feature(void)
+{
+	char buf[4096], *tok, *save;
+	int fd, ret;
+
+	fd = open(FEATURES, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ret = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (ret < 0)
+		return -1;
+	buf[ret] = '\0';
+
+	for (tok = strtok_r(buf, " \n", &save); tok;
+	     tok = strtok_r(NULL, " \n", &save)) {
+		if (!strcmp(tok, FEATURE))
+			return 1;
+		if (!strcmp(tok, "NO_" FEATURE))
+			return 0;
+	}
+
+	return -1;
+}
+
+static void set_feature(int on)
+{
+	if (write_file(FEATURES, on ? FEATURE : "NO_" FEATURE))
+		error(1, errno, "write %s", FEATURES);
+}
+
+static int enter_cgroup(const char *cg)
+{
+	char path[600], pid[16];
+
+	snprintf(path, sizeof(path), "%s/cgroup.procs", cg);
+	snprintf(pid, sizeof(pid), "%d", getpid());
+	return write_file(path, pid);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void burn(int us)
+{
+	unsigned long long end = now_ns() + us * 1000ULL;
+
+	while (now_ns() < end)
+		;
+}
+
+/* atexit() handler, also run by error() */
+static void cleanup(void)
+{
+	char path[512];
+	int i;
+
+	if (getpid() != main_pid)
+		return;
+
+	if (was_on >= 0)
+		write_file(FEATURES, was_on ? FEATURE : "NO_" FEATURE);
+
+	if (!base[0])
+		return;
+
+	enter_cgroup(cfg_root);
+	for (i = 0; i < nr_created; i++) {
+		snprintf(path, sizeof(path), "%s/cg%d", base, i);
+		rmdir(path);
+	}
+	rmdir(ctl);
+	rmdir(base);
+}
+
+static void setup(void)
+{
+	char path[512];
+	int i;
+
+	snprintf(base, sizeof(base), "%s/blocked_load.%d", cfg_root, getpid());
+	if (mkdir(base, 0755)) {
+		base[0] = '\0';
+		error(1, errno, "mkdir %s/blocked_load", cfg_root);
+	}
+
+	snprintf(path, sizeof(path), "%s/cgroup.subtree_control", base);
+	if (write_file(path, "+cpu")) {
+		fprintf(stderr, "SKIP: cpu controller not available\n");
+		exit(KSFT_SKIP);
+	}
+
+	/* Processes can only live in the leaves */
+	snprintf(ctl, sizeof(ctl), "%s/ctl", base);
+	if (mkdir(ctl, 0755))
+		error(1, errno, "mkdir %s", ctl);
+	if (enter_cgroup(ctl))
+		error(1, errno, "enter %s", ctl);
+
+	for (i = 0; i < cfg_cgroups; i++) {
+		snprintf(path, sizeof(path), "%s/cg%d", base, i);
+		if (mkdir(path, 0755))
+			error(1, errno, "mkdir %s", path);
+		nr_created++;
+	}
+}
+
+/* Leave some blocked load in every cgroup on every CPU */
+static void populate(void)
+{
+	int cpu, status, ret = 0;
+	char path[512];
+	pid_t pid;
+	int i;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &cpus))
+			continue;
+
+		pid = fork();
+		if (pid < 0)
+			error(1, errno, "fork");
+		if (pid)
+			continue;
+
+		/* Children leave with _exit(), not to run cleanup() */
+		if (pin(cpu))
+			_exit(1);
+		for (i = 0; i < cfg_cgroups; i++) {
+			snprintf(path, sizeof(path), "%s/cg%d", base, i);
+			if (enter_cgroup(path))
+				_exit(1);
+			burn(cfg_burn_us);
+		}
+		/* Back out, or the last cgroup could not be removed */
+		_exit(enter_cgroup(ctl) ? 1 : 0);
+	}
+
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			ret = 1;
+	}
+	if (ret)
+		error(1, 0, "populating the cgroups failed");
+}
+
+static void pong(int cpu, int rfd, int wfd)
+{
+	char c;
+
+	if (pin(cpu))
+		_exit(1);
+	while (read(rfd, &c, 1) == 1) {
+		if (write(wfd, &c, 1) != 1)
+			break;
+	}
+	_exit(0);
+}
+
+static unsigned long ping(void)
+{
+	unsigned long long end;
+	unsigned long rounds = 0;
+	int p2c[2], c2p[2];
+	pid_t child;
+	char c = 0;
+
+	if (pipe(p2c) || pipe(c2p))
+		error(1, errno, "pipe");
+
+	child = fork();
+	if (child < 0)
+		error(1, errno, "fork");
+	if (!child) {
+		close(p2c[1]);
+		close(c2p[0]);
+		pong(nth_cpu(1), p2c[0], c2p[1]);
+	}
+	close(p2c[0]);
+	close(c2p[1]);
+
+	if (pin(nth_cpu(0)))
+		error(1, errno, "sched_setaffinity");
+	end = now_ns() + cfg_duration * 1000000000ULL;
+	while (now_ns() < end) {
+		if (write(p2c[1], &c, 1) != 1 || read(c2p[0], &c, 1) != 1) {
+			kill(child, SIGKILL);
+			waitpid(child, NULL, 0);
+			error(1, errno, "ping");
+		}
+		rounds++;
+	}
+
+	close(p2c[1]);
+	close(c2p[0]);
+	waitpid(child, NULL, 0);
+
+	return rounds / cfg_duration;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-r cgroup root] [-n cgroups] [-d seconds] [-b burn us]\n",
+		prog);
+	exit(1);
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "r:n:d:b:")) != -1) {
+		switch (c) {
+		case 'r':
+			cfg_root = optarg;
+			break;
+		case 'n':
+			cfg_cgroups = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			cfg_duration = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			cfg_burn_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (cfg_cgroups < 0 || cfg_duration <= 0 || cfg_burn_us <= 0)
+		usage(argv[0]);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long start, populate_ms;
+	unsigned long rounds[2];
+	int on;
+
+	parse_opts(argc, argv);
+
+	if (geteuid()) {
+		fprintf(stderr, "SKIP: need root privileges\n");
+		return KSFT_SKIP;
+	}
+
+	if (sched_getaffinity(0, sizeof(cpus), &cpus))
+		error(1, errno, "sched_getaffinity");
+	if (CPU_COUNT(&cpus) < 2) {
+		fprintf(stderr, "SKIP: need two CPUs\n");
+		return KSFT_SKIP;
+	}
+
+	main_pid = getpid();
+	if (atexit(cleanup))
+		error(1, 0, "atexit");
+
+	was_on = read_feature();
+	if (was_on < 0) {
+		fprintf(stderr, "SKIP: %s not found in %s\n", FEATURE, FEATURES);
+		return KSFT_SKIP;
+	}
+
+	setup();
+
+	for (on = 0; on <= 1; on++) {
+		set_feature(on);
+
+		start = now_ns();
+		populate();
+		populate_ms = (now_ns() - start) / 1000000;
+		rounds[on] = ping();
+
+		printf("%s%s: cgroups %d cpus %d: populated in %llu ms, %lu round trips/s\n",
+		       on ? "" : "NO_", FEATURE, cfg_cgroups, CPU_COUNT(&cpus),
+		       populate_ms, rounds[on]);
+	}
+
+	if (rounds[1] * 100 < rounds[0] * MIN_RATIO) {
+		printf("FAIL: %s below %d%% of NO_%s\n", FEATURE, MIN_RATIO,
+		       FEATURE);
+		return KSFT_FAIL;
+	}
+
+	printf("PASS\n");
+	return KSFT_PASS;
+}